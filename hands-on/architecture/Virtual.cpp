@@ -6,6 +6,10 @@
 //  try to change the "pattern" in the vector of pointers
 //  use adhoc RTTI with -DADHOC_RTTI
 //   (then remove "final")
+//  use the SoA copy of the data with -DUSE_SOA (hotColumns.h)
+//   (vectorized at -O3 with -fopt-info-vec, not at -O2)
+//  use one array per type (typeBuckets.h) with -DUSE_BUCKETS
+//   (then remove "final", and the order of the vector of pointers?)
 //
 //
 //  change -O2 in -Ofast
@@ -100,6 +104,8 @@ struct C final : public A
   }
 };
 
+#include "hotColumns.h"
+#include "typeBuckets.h"
 #include <algorithm>
 #include <iostream>
 #include <memory>
@@ -133,18 +139,31 @@ int main()
                           : static_cast<B const*>(p)->comp();
   }
 #elif USE_SOA
-  // SOA
-  std::vector<int> types(pa.size());
-  std::vector<float> data(pa.size());
-  for (auto i = 0U; i < pa.size(); ++i) {
-    types[i] = pa[i]->type;
-    data[i]  = pa[i]->data();
-  }
+  // SOA: a copy of type and data() of each object (hotColumns.h)
+  hot::Snapshot<Base, float, 1> snap(
+      pa, [](Base const& b) { return b.type; },
+      {[](Base const& b) { return b.data(); }});
+  std::vector<float> comp(snap.size());
   std::cout << "using SOA" << std::endl;
   for (int i = 0; i < 20000;
        ++i) { // here we know that can be only either C or B
-    for (auto j = 0U; j < data.size(); ++j)
-      c += types[j] == 3 ? C::doComp(data[j]) : B::doComp(data[j]);
+    snap.apply<hot::Kind<B, 2>, hot::Kind<C, 3>>(
+        [](auto k, float x) { return decltype(k)::type::doComp(x); },
+        comp.data());
+    for (auto x : comp)
+      c += x;
+  }
+#elif USE_BUCKETS
+  // the same objects, copied in one array per type
+  buckets::Buckets<B, C> bk;
+  for (auto const& p : pa)
+    if (p->type == 3)
+      bk.push_back(*static_cast<C const*>(p));
+    else
+      bk.push_back(*static_cast<B const*>(p));
+  std::cout << "using type buckets" << std::endl;
+  for (int i = 0; i < 20000; ++i) {
+    bk.for_each([&](auto const& x) { c += x.comp(); });
   }
 #else
   std::cout << "using virtual function" << std::endl;
@@ -1,11 +1,14 @@
 //
 // compile with
-//  c++-52 -std=c++14 -O2 -Wall Virtual.cpp -fopt-info-vec
+//  c++ -std=c++17 -O2 -Wall VirtualAny.cpp -fopt-info-vec
 //
 //  comment out the random_shuffle
 //  try to change the "pattern" in the vector of pointers
 //  use adhoc RTTI with -DADHOC_RTTI
 //   (then remove "final")
+//  use objects stored in place (../backup/AnyOf.h) with -DVARIANT,
+//   dispatched by visit (a jump on the stored type)
+//  group them by type before the loop with -DVARIANT -DGROUPED
 //
 //
 //  change -O2 in -Ofast
@@ -78,7 +81,7 @@ struct C final : public A
   }
 };
 
-#include "AnyOf.h"
+#include "../backup/AnyOf.h"
 #include <algorithm>
 #include <iostream>
 #include <memory>
@@ -119,11 +122,23 @@ int main()
   }
   std::random_shuffle(anys.begin(), anys.end());
 
+#  ifdef GROUPED
+  // the same (shuffled) objects, grouped by type in place
+  AnyOfVector<Base, B, C> grouped;
+  grouped.reserve(anys.size());
+  for (auto const& p : anys)
+    grouped.push_back(p);
+  grouped.group();
+  std::cout << "using variant grouped by type" << std::endl;
+  for (int i = 0; i < 20000; ++i)
+    grouped.for_each([&](auto const& x) { c += x.comp(); });
+#  else
   std::cout << "using variant" << std::endl;
   for (int i = 0; i < 20000; ++i) {
     for (auto const& p : anys)
-      c += p.get<Base>()->type == 3 ? p.get<C>()->comp() : p.get<B>()->comp();
+      c += p.visit([](auto const& x) { return x.comp(); });
   }
+#  endif
 #else
   std::cout << "using virtual function" << std::endl;
   for (int i = 0; i < 20000; ++i) {
@@ -0,0 +1,202 @@
+//
+//  the loops of backend.cpp on an AoS std::vector<Point> against the SoA
+//  batch of vec3SoA.h: normalize, cross product, dot product and s a + b
+//
+//  c++ -O2 -march=native backendSol.cpp
+//  ./a.out --filter=normalize
+//
+//  normalizeAoS is the loop of backend.cpp (three norm() per point, three
+//  divisions), normalizeAoSOnce computes 1/norm once: how much of the gain
+//  is that, how much the layout?
+//
+#include "benchRunner.h"
+#include "vec3SoA.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+struct Point
+{
+  double norm() const
+  {
+    return std::sqrt(x * x + y * y + z * z);
+  }
+
+  double x, y, z;
+};
+
+Point cross(Point const& a, Point const& b)
+{
+  return {
+      a.y * b.z - a.z * b.y,
+      a.z * b.x - a.x * b.z,
+      a.x * b.y - a.y * b.x,
+  };
+}
+
+constexpr std::size_t N = 1024 * 8;
+
+// the same points in both layouts
+struct Data
+{
+  std::vector<Point> a, b, o;
+  vec3::Batch<double> sa, sb, so;
+
+  Data()
+      : a(N)
+      , b(N)
+      , o(N)
+      , sa(N)
+      , sb(N)
+      , so(N)
+  {
+    std::default_random_engine reng;
+    std::normal_distribution<double> gauss(10., 1.);
+    for (std::size_t i = 0; i < N; ++i) {
+      a[i] = {gauss(reng), gauss(reng), gauss(reng)};
+      b[i] = {gauss(reng), gauss(reng), gauss(reng)};
+      sa.set(i, a[i].x, a[i].y, a[i].z);
+      sb.set(i, b[i].x, b[i].y, b[i].z);
+    }
+  }
+
+  // largest difference between the two layouts of the output
+  double diff() const
+  {
+    double d = 0;
+    for (std::size_t i = 0; i < N; ++i)
+      d = std::max({d, std::abs(o[i].x - so.x()[i]),
+                    std::abs(o[i].y - so.y()[i]),
+                    std::abs(o[i].z - so.z()[i])});
+    return d;
+  }
+};
+
+template<int WHAT>
+void normalizeAoS(benchmark::State& st)
+{
+  Data d;
+  st.setItems(N);
+  while (st.next()) {
+    for (std::size_t i = 0; i < N; ++i) {
+      auto const& p = d.a[i];
+      if (WHAT == 0) {
+        d.o[i].x = p.x / p.norm();
+        d.o[i].y = p.y / p.norm();
+        d.o[i].z = p.z / p.norm();
+      } else {
+        double r = 1. / p.norm();
+        d.o[i]   = {p.x * r, p.y * r, p.z * r};
+      }
+    }
+    benchmark::keep(d.o);
+  }
+}
+
+void normalizeSoA(benchmark::State& st)
+{
+  Data d;
+  st.setItems(N);
+  while (st.next()) {
+    vec3::normalize(d.sa, d.so);
+    benchmark::keep(d.so);
+  }
+  for (std::size_t i = 0; i < N; ++i)
+    d.o[i] = {d.a[i].x / d.a[i].norm(), d.a[i].y / d.a[i].norm(),
+              d.a[i].z / d.a[i].norm()};
+  std::cout << "normalize, max difference " << d.diff() << std::endl;
+}
+
+void crossAoS(benchmark::State& st)
+{
+  Data d;
+  st.setItems(N);
+  while (st.next()) {
+    for (std::size_t i = 0; i < N; ++i)
+      d.o[i] = cross(d.a[i], d.b[i]);
+    benchmark::keep(d.o);
+  }
+}
+
+void crossSoA(benchmark::State& st)
+{
+  Data d;
+  st.setItems(N);
+  while (st.next()) {
+    vec3::cross(d.sa, d.sb, d.so);
+    benchmark::keep(d.so);
+  }
+  for (std::size_t i = 0; i < N; ++i)
+    d.o[i] = cross(d.a[i], d.b[i]);
+  std::cout << "cross, max difference " << d.diff() << std::endl;
+}
+
+void dotAoS(benchmark::State& st)
+{
+  Data d;
+  std::vector<double> r(N);
+  st.setItems(N);
+  while (st.next()) {
+    for (std::size_t i = 0; i < N; ++i)
+      r[i] = d.a[i].x * d.b[i].x + d.a[i].y * d.b[i].y + d.a[i].z * d.b[i].z;
+    benchmark::keep(r);
+  }
+}
+
+void dotSoA(benchmark::State& st)
+{
+  Data d;
+  std::vector<double> r(N);
+  st.setItems(N);
+  while (st.next()) {
+    vec3::dot(d.sa, d.sb, r.data());
+    benchmark::keep(r);
+  }
+  double diff = 0;
+  for (std::size_t i = 0; i < N; ++i)
+    diff = std::max(diff, std::abs(r[i]
+                                   - (d.a[i].x * d.b[i].x + d.a[i].y * d.b[i].y
+                                      + d.a[i].z * d.b[i].z)));
+  std::cout << "dot, max difference " << diff << std::endl;
+}
+
+void scaleAddAoS(benchmark::State& st)
+{
+  Data d;
+  double s = 0.5;
+  st.setItems(N);
+  while (st.next()) {
+    for (std::size_t i = 0; i < N; ++i)
+      d.o[i] = {s * d.a[i].x + d.b[i].x, s * d.a[i].y + d.b[i].y,
+                s * d.a[i].z + d.b[i].z};
+    benchmark::keep(d.o);
+  }
+}
+
+void scaleAddSoA(benchmark::State& st)
+{
+  Data d;
+  st.setItems(N);
+  while (st.next()) {
+    vec3::scaleAdd(0.5, d.sa, d.sb, d.so);
+    benchmark::keep(d.so);
+  }
+  for (std::size_t i = 0; i < N; ++i)
+    d.o[i] = {0.5 * d.a[i].x + d.b[i].x, 0.5 * d.a[i].y + d.b[i].y,
+              0.5 * d.a[i].z + d.b[i].z};
+  std::cout << "scaleAdd, max difference " << d.diff() << std::endl;
+}
+
+BENCHMARK(normalizeAoS<0>);
+BENCHMARK(normalizeAoS<1>);
+BENCHMARK(normalizeSoA);
+BENCHMARK(crossAoS);
+BENCHMARK(crossSoA);
+BENCHMARK(dotAoS);
+BENCHMARK(dotSoA);
+BENCHMARK(scaleAddAoS);
+BENCHMARK(scaleAddSoA);
+
+BENCHMARK_MAIN()
@@ -0,0 +1,417 @@
+#ifndef BENCH_BASELINE_H
+#define BENCH_BASELINE_H
+//
+//  store of benchmark results and comparison against a baseline
+//
+//  the JSON written by benchRunner.h (--json=file) carries the context of the
+//  run (cpu model and flags, compiler, ISA macros, commit) and all the raw
+//  samples, so that it can be used later as a baseline:
+//
+//    ./a.out --json=base.json
+//    ... change code or compiler flags ...
+//    ./a.out --baseline=base.json      (exit code 1 on a significant slowdown)
+//
+//  a baseline that cannot be read, or has no benchmark, is an error (exit
+//  code 2, before running anything). The kernels in only one of the two
+//  runs are listed, and none in common counts as a failure
+//
+//  or offline with benchCompare.cpp:  benchCompare base.json new.json
+//
+//  a kernel is flagged as "slower" if a one-sided Mann-Whitney U test on the
+//  samples rejects "not slower" at level alpha and the ratio of the medians
+//  is above 1+threshold (so that statistically significant but irrelevant
+//  differences are not reported)
+//
+//  the commit is taken from -DBENCH_COMMIT=... or from "git rev-parse", the
+//  compiler options from -DBENCH_CFLAGS=... if given
+//
+
+#include "isaDispatch.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace benchmark {
+
+// a minimal JSON reader, enough for what the runner writes
+struct Json
+{
+  enum Type
+  {
+    Null,
+    Bool,
+    Number,
+    String,
+    Array,
+    Object,
+    Invalid // not JSON: the parsing stopped there, and so did its parents
+  };
+  Type type  = Null;
+  double num = 0;
+  std::string str;
+  std::vector<Json> arr;
+  std::vector<std::pair<std::string, Json>> obj;
+
+  Json const* find(std::string const& key) const
+  {
+    for (auto const& kv : obj)
+      if (kv.first == key)
+        return &kv.second;
+    return nullptr;
+  }
+  std::string getString(std::string const& key) const
+  {
+    auto j = find(key);
+    return j && j->type == String ? j->str : std::string();
+  }
+  double getNumber(std::string const& key) const
+  {
+    auto j = find(key);
+    return j && j->type == Number ? j->num : 0.;
+  }
+
+  static Json parse(std::string const& s)
+  {
+    std::size_t i = 0;
+    return parse(s, i);
+  }
+
+private:
+  static void ws(std::string const& s, std::size_t& i)
+  {
+    while (i < s.size() && std::isspace((unsigned char)s[i]))
+      ++i;
+  }
+  static std::string parseString(std::string const& s, std::size_t& i)
+  {
+    std::string r;
+    for (++i; i < s.size() && s[i] != '"'; ++i) {
+      if (s[i] == '\\' && i + 1 < s.size())
+        ++i;
+      r += s[i];
+    }
+    ++i;
+    return r;
+  }
+  static Json parse(std::string const& s, std::size_t& i)
+  {
+    Json j;
+    ws(s, i);
+    if (i >= s.size())
+      return j;
+    auto c = s[i];
+    if (c == '{') {
+      j.type = Object;
+      ++i;
+      for (ws(s, i); i < s.size() && s[i] != '}'; ws(s, i)) {
+        if (s[i] == ',') {
+          ++i;
+          continue;
+        }
+        auto key = parseString(s, i);
+        ws(s, i);
+        ++i; // ':'
+        j.obj.emplace_back(key, parse(s, i));
+        if (j.obj.back().second.type == Invalid)
+          j.type = Invalid;
+      }
+      if (i >= s.size()) // truncated
+        j.type = Invalid;
+      ++i;
+    } else if (c == '[') {
+      j.type = Array;
+      ++i;
+      for (ws(s, i); i < s.size() && s[i] != ']'; ws(s, i)) {
+        if (s[i] == ',') {
+          ++i;
+          continue;
+        }
+        j.arr.push_back(parse(s, i));
+        if (j.arr.back().type == Invalid)
+          j.type = Invalid;
+      }
+      if (i >= s.size()) // truncated
+        j.type = Invalid;
+      ++i;
+    } else if (c == '"') {
+      j.type = String;
+      j.str  = parseString(s, i);
+    } else if (s.compare(i, 4, "true") == 0 || s.compare(i, 5, "false") == 0) {
+      j.type = Bool;
+      j.num  = c == 't';
+      i += c == 't' ? 4 : 5;
+    } else if (s.compare(i, 4, "null") == 0) {
+      i += 4;
+    } else {
+      j.type = Number;
+      char* end;
+      j.num = std::strtod(s.c_str() + i, &end);
+      if (end == s.c_str() + i) {
+        // nothing read: the loops above would not move
+        j.type = Invalid;
+        i      = s.size();
+        return j;
+      }
+      i = end - s.c_str();
+    }
+    return j;
+  }
+};
+
+// where and how the results were produced
+struct Context
+{
+  std::vector<std::pair<std::string, std::string>> items;
+
+  std::string get(std::string const& key) const
+  {
+    for (auto const& kv : items)
+      if (kv.first == key)
+        return kv.second;
+    return std::string();
+  }
+
+  static std::string cpuinfo(std::string const& key)
+  {
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(in, line))
+      if (line.compare(0, key.size(), key) == 0) {
+        auto p = line.find(':');
+        if (p != std::string::npos)
+          return line.substr(line.find_first_not_of(' ', p + 1));
+      }
+    return std::string();
+  }
+
+  static std::string command(char const* cmd)
+  {
+    std::string r;
+    if (auto f = popen(cmd, "r")) {
+      char buf[256];
+      while (fgets(buf, sizeof(buf), f))
+        r += buf;
+      pclose(f);
+    }
+    while (!r.empty() && std::isspace((unsigned char)r.back()))
+      r.pop_back();
+    return r;
+  }
+
+  // the ISA the code was compiled for (-march)
+  static std::string isa()
+  {
+    std::string r;
+#ifdef __SSE4_2__
+    r += " sse4.2";
+#endif
+#ifdef __AVX__
+    r += " avx";
+#endif
+#ifdef __AVX2__
+    r += " avx2";
+#endif
+#ifdef __FMA__
+    r += " fma";
+#endif
+#ifdef __AVX512F__
+    r += " avx512f";
+#endif
+#ifdef __FAST_MATH__
+    r += " fast-math";
+#endif
+    return r.empty() ? r : r.substr(1);
+  }
+
+  static Context current()
+  {
+    Context c;
+    c.items.emplace_back("cpu", cpuinfo("model name"));
+    c.items.emplace_back("cpu_flags", cpuinfo("flags"));
+    c.items.emplace_back("compiler", __VERSION__);
+    c.items.emplace_back("isa", isa());
+    // the version picked by the dispatched kernels (BENCH_ISA)
+    c.items.emplace_back("isa_runtime", isa::name(isa::selected()));
+#ifdef BENCH_CFLAGS
+    c.items.emplace_back("cflags", BENCH_CFLAGS);
+#endif
+#ifdef BENCH_COMMIT
+    c.items.emplace_back("commit", BENCH_COMMIT);
+#else
+    c.items.emplace_back("commit",
+                         command("git rev-parse --short HEAD 2>/dev/null"));
+#endif
+    c.items.emplace_back("date", command("date -u +%Y-%m-%dT%H:%M:%SZ"));
+    return c;
+  }
+
+  static std::string escape(std::string const& s)
+  {
+    std::string r;
+    for (auto c : s) {
+      if (c == '"' || c == '\\')
+        r += '\\';
+      r += c;
+    }
+    return r;
+  }
+
+  void write(std::ostream& co) const
+  {
+    co << '{';
+    for (auto i = 0U; i < items.size(); ++i)
+      co << (i ? ", " : "") << '"' << items[i].first << "\": \""
+         << escape(items[i].second) << '"';
+    co << '}';
+  }
+};
+
+// p-value of "b is not larger than a" (one-sided Mann-Whitney U test,
+// normal approximation with tie correction)
+inline double mannWhitneyGreater(std::vector<double> const& a,
+                                 std::vector<double> const& b)
+{
+  double na = a.size(), nb = b.size();
+  if (na < 2 || nb < 2)
+    return 1.;
+  std::vector<std::pair<double, int>> all;
+  for (auto x : a)
+    all.emplace_back(x, 0);
+  for (auto x : b)
+    all.emplace_back(x, 1);
+  std::sort(all.begin(), all.end());
+  // ranks (average for ties) and tie correction
+  double rb = 0, ties = 0;
+  for (std::size_t i = 0; i < all.size();) {
+    auto j = i;
+    while (j < all.size() && all[j].first == all[i].first)
+      ++j;
+    double rank = 0.5 * (i + j + 1);
+    double t    = j - i;
+    ties += t * t * t - t;
+    for (auto k = i; k < j; ++k)
+      if (all[k].second == 1)
+        rb += rank;
+    i = j;
+  }
+  double n     = na + nb;
+  double u     = rb - nb * (nb + 1) / 2;
+  double mu    = na * nb / 2;
+  double sigma = std::sqrt(na * nb / 12 * ((n + 1) - ties / (n * (n - 1))));
+  if (sigma <= 0)
+    return 1.;
+  double z = (u - mu - 0.5) / sigma; // continuity correction
+  return 0.5 * std::erfc(z / std::sqrt(2.));
+}
+
+struct Stored
+{
+  double median = 0;
+  std::vector<double> samples;
+};
+
+struct Baseline
+{
+  Context context;
+  std::map<std::string, Stored> results;
+  std::string error; // why load() failed, empty if it did not
+
+  // a file that cannot be read or has no benchmark is an error (a typo in
+  // --baseline= must not pass as "no slowdown")
+  static Baseline load(std::string const& file)
+  {
+    Baseline b;
+    std::ifstream in(file);
+    if (!in) {
+      b.error = "cannot open " + file;
+      return b;
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    auto j = Json::parse(ss.str());
+    if (j.type == Json::Invalid) {
+      b.error = "cannot parse " + file;
+      return b;
+    }
+    if (auto c = j.find("context"))
+      for (auto const& kv : c->obj)
+        b.context.items.emplace_back(kv.first, kv.second.str);
+    if (auto bs = j.find("benchmarks"))
+      for (auto const& r : bs->arr) {
+        auto& s  = b.results[r.getString("name")];
+        s.median = r.getNumber("median_ns");
+        if (auto v = r.find("samples_ns"))
+          for (auto const& x : v->arr)
+            s.samples.push_back(x.num);
+      }
+    if (b.results.empty())
+      b.error = "no benchmark in " + file;
+    return b;
+  }
+};
+
+struct CompareOptions
+{
+  double alpha     = 0.01; // significance of the test
+  double threshold = 0.02; // minimal relevant slowdown of the median
+};
+
+// prints the comparison, returns the number of significant slowdowns,
+// plus one if no kernel is in both. The kernels in only one of them are
+// listed (not an error: --filter runs a subset)
+inline int compare(std::ostream& co, Baseline const& base,
+                   Baseline const& now, CompareOptions const& opt)
+{
+  for (auto key : {"cpu", "compiler", "isa", "isa_runtime", "cflags"})
+    if (base.context.get(key) != now.context.get(key))
+      co << "warning: different " << key << ": \"" << base.context.get(key)
+         << "\" vs \"" << now.context.get(key) << '"' << std::endl;
+  int slower = 0, common = 0;
+  char buf[256];
+  for (auto const& r : now.results) {
+    auto b = base.results.find(r.first);
+    if (b == base.results.end()) {
+      co << r.first << ": not in the baseline" << std::endl;
+      continue;
+    }
+    ++common;
+    auto const& s0 = b->second;
+    auto const& s1 = r.second;
+    double ratio   = s0.median > 0 ? s1.median / s0.median : 0;
+    double pSlow   = mannWhitneyGreater(s0.samples, s1.samples);
+    double pFast   = mannWhitneyGreater(s1.samples, s0.samples);
+    char const* verdict = "same";
+    if (pSlow < opt.alpha && ratio > 1 + opt.threshold) {
+      verdict = "SLOWER";
+      ++slower;
+    } else if (pFast < opt.alpha && ratio < 1 - opt.threshold) {
+      verdict = "faster";
+    }
+    snprintf(buf, sizeof(buf), "%-32s %12.4g -> %12.4g ns  x%6.3f  p=%8.2g  %s",
+             r.first.c_str(), s0.median, s1.median, ratio,
+             std::min(pSlow, pFast), verdict);
+    co << buf << std::endl;
+  }
+  for (auto const& b : base.results)
+    if (now.results.find(b.first) == now.results.end())
+      co << b.first << ": in the baseline, missing from this run"
+         << std::endl;
+  if (common == 0) {
+    co << "error: no kernel to compare" << std::endl;
+    ++slower;
+  }
+  return slower;
+}
+
+} // namespace benchmark
+
+#endif
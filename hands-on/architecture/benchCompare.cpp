@@ -0,0 +1,45 @@
+//
+// compares two result files written with --json=file by benchRunner.h
+//
+// compile with
+//  c++ -O2 -Wall benchCompare.cpp -o benchCompare
+//
+//  ./benchCompare base.json new.json [--alpha=0.01] [--threshold=0.02]
+//
+// exit code is 1 if any kernel is significantly slower (or none is in both
+// files), 2 if a file cannot be read or has no benchmark
+//
+
+#include "benchBaseline.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+  using namespace benchmark;
+  std::vector<std::string> files;
+  CompareOptions opt;
+  for (int i = 1; i < argc; ++i) {
+    std::string a = argv[i];
+    if (a.compare(0, 8, "--alpha=") == 0)
+      opt.alpha = std::atof(a.c_str() + 8);
+    else if (a.compare(0, 12, "--threshold=") == 0)
+      opt.threshold = std::atof(a.c_str() + 12);
+    else
+      files.push_back(a);
+  }
+  if (files.size() != 2) {
+    std::cerr << "usage: " << argv[0]
+              << " base.json new.json [--alpha=p] [--threshold=r]" << std::endl;
+    return 2;
+  }
+  auto base = Baseline::load(files[0]);
+  auto now  = Baseline::load(files[1]);
+  for (auto const* b : {&base, &now})
+    if (!b->error.empty()) {
+      std::cerr << "error: " << b->error << std::endl;
+      return 2;
+    }
+  return compare(std::cout, base, now, opt) > 0 ? 1 : 0;
+}
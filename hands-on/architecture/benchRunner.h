@@ -0,0 +1,678 @@
+#ifndef BENCH_RUNNER_H
+#define BENCH_RUNNER_H
+//
+//  a small statistical runner for the hands-on kernels
+//
+//  a kernel is a function taking a benchmark::State&: it does its own setup
+//  and then loops on State::next(), each iteration being one timed sample
+//
+//    void mmultKernel(benchmark::State& st)
+//    {
+//      ... setup (not timed) ...
+//      while (st.next()) {
+//        st.pause();
+//        ... re-initialization (not timed) ...
+//        st.resume();
+//        ... timed region ...
+//      }
+//    }
+//    BENCHMARK(mmultKernel);
+//    BENCHMARK_MAIN()
+//
+//  the runner discards a few warmup samples, then keeps sampling until the
+//  relative MAD (median absolute deviation) is below target, or a maximum
+//  number of samples (or time) is reached.
+//  Samples further than "outlier" MADs from the median are rejected before
+//  computing median, MAD, mean and percentiles.
+//
+//  samples are timed with the calibrated TSC of cycleTimer.h (its overhead
+//  subtracted), so that sub-microsecond regions are meaningful;
+//  --timer=steady uses std::chrono::steady_clock instead (the only one off
+//  x86, where --cache=flush also degrades to thrash)
+//
+//  with --counters the hardware counters of perfCounters.h bracket the same
+//  timed region (pause/resume included) and are reported per sample and
+//  per item, together with the IPC
+//
+//  --cache=warm|flush|thrash|cold|tlb puts the caches (or the TLB) in a known
+//  state each time the timing starts or resumes (see cacheState.h); "flush"
+//  applies to the regions registered with st.addWorkingSet(p, bytes), and
+//  warns if there is none ("cold" is then "thrash"). An unknown mode is an
+//  error
+//
+//  kernels declaring their flops and bytes per sample (setFlops/setBytes)
+//  are placed on the roofline of the host with --roofline (see roofline.h):
+//  GFLOP/s and arithmetic intensity come from these declared counts, not
+//  from a measurement (with --counters the DRAM traffic is also measured)
+//
+//  the JSON output keeps the raw samples and the context of the run, and can
+//  be used as a baseline for a later run (see benchBaseline.h)
+//
+//  command line options:
+//    --filter=substr --warmup=n --min-reps=n --max-reps=n --max-time=seconds
+//    --target=relMAD --outlier=nMAD --json=file --csv=file --counters
+//    --timer=tsc|steady --roofline --cache=mode
+//    --baseline=file --alpha=pvalue --threshold=relSlowdown
+//
+
+#include "benchBaseline.h"
+#include "benchmark.h"
+#include "cacheState.h"
+#include "cycleTimer.h"
+#include "perfCounters.h"
+#include "roofline.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+struct Options
+{
+  int warmup        = 3;
+  int minReps       = 10;
+  int maxReps       = 1000;
+  double maxTime    = 10.;   // seconds per kernel
+  double target     = 0.01;  // relative MAD to stop sampling
+  double outlier    = 5.;    // rejection threshold in units of MAD
+  bool counters     = false;
+  bool roofline     = false;
+  std::string timer = "tsc"; // or "steady"
+  std::string cache = "warm";
+  std::string filter;
+  std::string json;
+  std::string csv;
+  std::string baseline;
+  CompareOptions compare;
+};
+
+struct Stats
+{
+  int n         = 0;
+  int rejected  = 0;
+  double median = 0, mad = 0, mean = 0, min = 0, max = 0;
+  double p05 = 0, p25 = 0, p75 = 0, p95 = 0;
+
+  // v must be sorted
+  static double percentile(std::vector<double> const& v, double q)
+  {
+    if (v.empty())
+      return 0;
+    double x = q * (v.size() - 1);
+    auto i   = std::size_t(x);
+    if (i + 1 >= v.size())
+      return v.back();
+    return v[i] + (x - i) * (v[i + 1] - v[i]);
+  }
+
+  static double madOf(std::vector<double> const& v, double med)
+  {
+    std::vector<double> d(v.size());
+    for (auto i = 0U; i < v.size(); ++i)
+      d[i] = std::abs(v[i] - med);
+    std::sort(d.begin(), d.end());
+    return percentile(d, 0.5);
+  }
+
+  static Stats compute(std::vector<double> v, double outlier)
+  {
+    Stats s;
+    if (v.empty())
+      return s;
+    std::sort(v.begin(), v.end());
+    auto med = percentile(v, 0.5);
+    auto mad = madOf(v, med);
+    // 1.4826*MAD estimates sigma for gaussian noise
+    if (mad > 0 && outlier > 0 && v.size() >= 5) {
+      auto cut = outlier * 1.4826 * mad;
+      auto n   = v.size();
+      v.erase(std::remove_if(v.begin(), v.end(),
+                             [&](double x) { return std::abs(x - med) > cut; }),
+              v.end());
+      s.rejected = n - v.size();
+    }
+    s.n      = v.size();
+    s.median = percentile(v, 0.5);
+    s.mad    = madOf(v, s.median);
+    s.min    = v.front();
+    s.max    = v.back();
+    s.p05    = percentile(v, 0.05);
+    s.p25    = percentile(v, 0.25);
+    s.p75    = percentile(v, 0.75);
+    s.p95    = percentile(v, 0.95);
+    double sum = 0;
+    for (auto x : v)
+      sum += x;
+    s.mean = sum / s.n;
+    return s;
+  }
+};
+
+class State
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit State(Options const& opt)
+      : opt_(opt)
+  {
+    cacheMode(opt_.cache, cacheMode_);
+    if (opt_.counters)
+      counters_ = std::make_unique<PerfCounters>();
+  }
+
+  // closes the current sample (if any) and opens a new one
+  // returns false when enough samples have been collected
+  bool next()
+  {
+    auto now = stop();
+    if (counters_)
+      counters_->pause();
+    if (running_) {
+      // each stop/start pair (pause/resume included) costs one overhead
+      double dt = now - t0_ - excluded_ - (1 + nPause_) * overhead();
+      dt        = tsc_ ? tsc::toNs(dt) : dt;
+      if (warm_ < opt_.warmup)
+        ++warm_;
+      else
+        samples_.push_back(std::max(0., dt));
+      // counts of the warmup samples are dropped
+      if (counters_ && samples_.empty())
+        counters_->reset();
+      if (done()) {
+        running_ = false;
+        if (counters_)
+          counters_->read();
+        return false;
+      }
+    } else {
+      begin_ = Clock::now();
+      warnCache();
+      if (counters_)
+        counters_->reset();
+    }
+    running_  = true;
+    excluded_ = 0;
+    nPause_   = 0;
+    cache_.prepare(cacheMode_);
+    if (counters_)
+      counters_->resume();
+    t0_ = start();
+    return true;
+  }
+
+  // exclude a region inside a sample from the timing
+  void pause()
+  {
+    tp_ = stop();
+    if (counters_)
+      counters_->pause();
+  }
+  void resume()
+  {
+    cache_.prepare(cacheMode_);
+    if (counters_)
+      counters_->resume();
+    excluded_ += start() - tp_;
+    ++nPause_;
+  }
+
+  // number of elements processed in each sample (for ns/item)
+  void setItems(double n)
+  {
+    items_ = n;
+  }
+  double items() const
+  {
+    return items_;
+  }
+
+  // a memory region to be flushed with --cache=flush (or cold)
+  void addWorkingSet(void const* p, std::size_t bytes)
+  {
+    cache_.add(p, bytes);
+  }
+
+  // floating point operations in each sample
+  void setFlops(double n)
+  {
+    flops_ = n;
+  }
+  // bytes read+written in each sample and size of the data touched
+  // (same as bytes if not given)
+  void setBytes(double bytes, double workingSet = 0)
+  {
+    bytes_      = bytes;
+    workingSet_ = workingSet > 0 ? workingSet : bytes;
+  }
+  double flops() const
+  {
+    return flops_;
+  }
+  double bytes() const
+  {
+    return bytes_;
+  }
+  double workingSet() const
+  {
+    return workingSet_;
+  }
+
+  std::vector<double> const& samples() const
+  {
+    return samples_;
+  }
+
+  // null unless --counters
+  PerfCounters const* counters() const
+  {
+    return counters_.get();
+  }
+
+private:
+  // time stamps in TSC ticks or in ns
+  double start() const
+  {
+    return tsc_ ? double(tsc::begin()) : steadyNs();
+  }
+  double stop() const
+  {
+    return tsc_ ? double(tsc::end()) : steadyNs();
+  }
+  static double steadyNs()
+  {
+    return std::chrono::duration<double, std::nano>(
+               Clock::now().time_since_epoch())
+        .count();
+  }
+  double overhead() const
+  {
+    return tsc_ ? tsc::calibration().overhead : 0.;
+  }
+
+  // at the first sample, when the working set is (not) registered already
+  void warnCache() const
+  {
+    if (!cache_.empty())
+      return;
+    if (cacheMode_ == CacheMode::Flush)
+      std::cerr << "warning: --cache=flush without st.addWorkingSet(): "
+                   "nothing is flushed"
+                << std::endl;
+    else if (cacheMode_ == CacheMode::Cold)
+      std::cerr << "warning: --cache=cold without st.addWorkingSet(): "
+                   "thrash instead"
+                << std::endl;
+  }
+
+  bool done() const
+  {
+    int n = samples_.size();
+    if (n >= opt_.maxReps)
+      return true;
+    auto elapsed = std::chrono::duration<double>(Clock::now() - begin_);
+    if (n > 0 && elapsed.count() > opt_.maxTime)
+      return true;
+    if (n < opt_.minReps)
+      return false;
+    // no need to recompute the statistics at each sample
+    if (n % opt_.minReps != 0)
+      return false;
+    auto v = samples_;
+    std::sort(v.begin(), v.end());
+    auto med = Stats::percentile(v, 0.5);
+    return med > 0 && Stats::madOf(v, med) <= opt_.target * med;
+  }
+
+  Options const& opt_;
+  bool tsc_            = opt_.timer == "tsc" && tsc::available;
+  CacheMode cacheMode_ = CacheMode::Warm;
+  CacheState cache_;
+  std::unique_ptr<PerfCounters> counters_;
+  std::vector<double> samples_;
+  int warm_          = 0;
+  bool running_      = false;
+  double t0_         = 0;
+  double tp_         = 0;
+  double excluded_   = 0;
+  int nPause_        = 0;
+  double items_      = 0;
+  double flops_      = 0;
+  double bytes_      = 0;
+  double workingSet_ = 0;
+  Clock::time_point begin_;
+};
+
+using Kernel = std::function<void(State&)>;
+
+struct Entry
+{
+  std::string name;
+  Kernel kernel;
+  std::function<void(Options&)> tune = [](Options&) {};
+
+  // per-kernel defaults (the command line still wins)
+  Entry& warmup(int n)
+  {
+    return chain([=](Options& o) { o.warmup = n; });
+  }
+  Entry& minReps(int n)
+  {
+    return chain([=](Options& o) { o.minReps = n; });
+  }
+  Entry& maxReps(int n)
+  {
+    return chain([=](Options& o) { o.maxReps = n; });
+  }
+  Entry& maxTime(double s)
+  {
+    return chain([=](Options& o) { o.maxTime = s; });
+  }
+
+private:
+  Entry& chain(std::function<void(Options&)> f)
+  {
+    tune = [prev = tune, f](Options& o) {
+      prev(o);
+      f(o);
+    };
+    return *this;
+  }
+};
+
+// a deque does not invalidate references on push_back
+inline std::deque<Entry>& registry()
+{
+  static std::deque<Entry> r;
+  return r;
+}
+
+inline Entry& registerKernel(std::string name, Kernel k)
+{
+  registry().push_back(Entry{std::move(name), std::move(k)});
+  return registry().back();
+}
+
+struct Result
+{
+  std::string name;
+  Stats stats;
+  double items      = 0;
+  double flops      = 0;
+  double bytes      = 0;
+  double workingSet = 0;
+  std::vector<double> samples;
+  // average per sample, only the events available on this host
+  std::vector<std::pair<std::string, double>> counters;
+
+  double counter(std::string const& what) const
+  {
+    for (auto const& c : counters)
+      if (c.first == what)
+        return c.second;
+    return 0;
+  }
+};
+
+inline void parseOptions(Options& o, int argc, char** argv)
+{
+  for (int i = 1; i < argc; ++i) {
+    std::string a = argv[i];
+    auto eq       = a.find('=');
+    if (a.compare(0, 2, "--") != 0)
+      continue;
+    auto key = a.substr(2, eq == std::string::npos ? eq : eq - 2);
+    auto val = eq == std::string::npos ? std::string() : a.substr(eq + 1);
+    if (key == "counters")
+      o.counters = val.empty() || std::atoi(val.c_str()) != 0;
+    else if (key == "roofline")
+      o.roofline = val.empty() || std::atoi(val.c_str()) != 0;
+    else if (key == "cache")
+      o.cache = val;
+    else if (key == "timer")
+      o.timer = val;
+    else if (key == "filter")
+      o.filter = val;
+    else if (key == "warmup")
+      o.warmup = std::atoi(val.c_str());
+    else if (key == "min-reps")
+      o.minReps = std::max(1, std::atoi(val.c_str()));
+    else if (key == "max-reps")
+      o.maxReps = std::max(1, std::atoi(val.c_str()));
+    else if (key == "max-time")
+      o.maxTime = std::atof(val.c_str());
+    else if (key == "target")
+      o.target = std::atof(val.c_str());
+    else if (key == "outlier")
+      o.outlier = std::atof(val.c_str());
+    else if (key == "json")
+      o.json = val;
+    else if (key == "csv")
+      o.csv = val;
+    else if (key == "baseline")
+      o.baseline = val;
+    else if (key == "alpha")
+      o.compare.alpha = std::atof(val.c_str());
+    else if (key == "threshold")
+      o.compare.threshold = std::atof(val.c_str());
+  }
+}
+
+inline Result run(Entry const& e, Options const& opt)
+{
+  State st(opt);
+  e.kernel(st);
+  Result r;
+  r.name    = e.name;
+  r.items      = st.items();
+  r.flops      = st.flops();
+  r.bytes      = st.bytes();
+  r.workingSet = st.workingSet();
+  r.samples    = st.samples();
+  r.stats      = Stats::compute(r.samples, opt.outlier);
+  auto pc      = st.counters();
+  if (pc && pc->available() && !r.samples.empty())
+    for (int e = 0; e < PerfCounters::NEvents; ++e)
+      if (pc->has(e))
+        r.counters.emplace_back(PerfCounters::name(e),
+                                pc->value(e) / r.samples.size());
+  return r;
+}
+
+inline void printResult(std::ostream& co, Result const& r)
+{
+  auto const& s = r.stats;
+  double rel    = s.median > 0 ? 100. * s.mad / s.median : 0.;
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "%-32s %12.4g ns +- %5.2f%%  [p05 %10.4g p95 %10.4g]  n=%d rej=%d",
+           r.name.c_str(), s.median, rel, s.p05, s.p95, s.n, s.rejected);
+  co << buf;
+  if (r.items > 0) {
+    snprintf(buf, sizeof(buf), "  %8.4g ns/item", s.median / r.items);
+    co << buf;
+  }
+  if (r.flops > 0 && s.median > 0) {
+    snprintf(buf, sizeof(buf), "  %8.4g GFLOP/s", r.flops / s.median);
+    co << buf;
+  }
+  co << std::endl;
+  if (r.counters.empty())
+    return;
+  auto cycles = r.counter("cycles");
+  if (cycles > 0) {
+    snprintf(buf, sizeof(buf), "%32s IPC %.3f", "",
+             r.counter("instructions") / cycles);
+    co << buf;
+  }
+  for (auto const& c : r.counters) {
+    auto n = r.items > 0 ? r.items : 1.;
+    snprintf(buf, sizeof(buf), "  %s%s %.4g", c.first.c_str(),
+             r.items > 0 ? "/item" : "", c.second / n);
+    co << buf;
+  }
+  co << std::endl;
+}
+
+inline void printRoofline(std::ostream& co, std::vector<Result> const& res)
+{
+  auto const& m = roofline::machine();
+  co << "\nroofline of this host" << std::endl;
+  roofline::print(co, m);
+  co << "flops and bytes as declared by each kernel (setFlops/setBytes), not "
+        "measured"
+     << (res.empty() || res[0].counters.empty()
+             ? " (--counters adds the DRAM traffic from LLC misses)"
+             : "")
+     << std::endl;
+  char buf[256];
+  for (auto const& r : res) {
+    if (r.flops <= 0 || r.stats.median <= 0)
+      continue;
+    auto p = roofline::place(m, r.flops, r.bytes, r.workingSet, r.stats.median);
+    snprintf(buf, sizeof(buf),
+             "%-32s %8.2f GFLOP/s  AI %8.3g flop/byte  in %-4s  roof %8.2f "
+             "(%4.1f%%)  %s",
+             r.name.c_str(), p.gflops, p.intensity, p.level.c_str(), p.roof,
+             100. * p.gflops / p.roof,
+             p.computeBound ? "compute bound" : "bandwidth bound");
+    co << buf << std::endl;
+    // memory traffic actually seen by the LLC
+    auto llc = r.counter("LLC-misses");
+    if (llc > 0) {
+      snprintf(buf, sizeof(buf), "%32s  measured DRAM AI %8.3g flop/byte", "",
+               r.flops / (64. * llc));
+      co << buf << std::endl;
+    }
+  }
+}
+
+inline void writeJSON(std::ostream& co, std::vector<Result> const& res)
+{
+  co << "{\n  \"context\": ";
+  Context::current().write(co);
+  co << ",\n  \"benchmarks\": [";
+  for (auto i = 0U; i < res.size(); ++i) {
+    auto const& r = res[i];
+    auto const& s = r.stats;
+    co << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\""
+       << ", \"n\": " << s.n << ", \"rejected\": " << s.rejected
+       << ", \"median_ns\": " << s.median << ", \"mad_ns\": " << s.mad
+       << ", \"mean_ns\": " << s.mean << ", \"min_ns\": " << s.min
+       << ", \"max_ns\": " << s.max << ", \"p05_ns\": " << s.p05
+       << ", \"p25_ns\": " << s.p25 << ", \"p75_ns\": " << s.p75
+       << ", \"p95_ns\": " << s.p95 << ", \"items\": " << r.items
+       << ", \"flops\": " << r.flops << ", \"bytes\": " << r.bytes;
+    if (!r.counters.empty()) {
+      co << ", \"counters\": {";
+      for (auto j = 0U; j < r.counters.size(); ++j)
+        co << (j ? ", " : "") << '"' << r.counters[j].first
+           << "\": " << r.counters[j].second;
+      co << '}';
+    }
+    co << ", \"samples_ns\": [";
+    for (auto j = 0U; j < r.samples.size(); ++j)
+      co << (j ? ", " : "") << r.samples[j];
+    co << "]}";
+  }
+  co << "\n  ]\n}\n";
+}
+
+inline void writeCSV(std::ostream& co, std::vector<Result> const& res)
+{
+  co << "name,n,rejected,median_ns,mad_ns,mean_ns,min_ns,max_ns,p05_ns,p25_ns,"
+        "p75_ns,p95_ns,items,flops,bytes";
+  for (int e = 0; e < PerfCounters::NEvents; ++e)
+    co << ',' << PerfCounters::name(e);
+  co << '\n';
+  for (auto const& r : res) {
+    auto const& s = r.stats;
+    co << r.name << ',' << s.n << ',' << s.rejected << ',' << s.median << ','
+       << s.mad << ',' << s.mean << ',' << s.min << ',' << s.max << ','
+       << s.p05 << ',' << s.p25 << ',' << s.p75 << ',' << s.p95 << ','
+       << r.items << ',' << r.flops << ',' << r.bytes;
+    for (int e = 0; e < PerfCounters::NEvents; ++e)
+      co << ',' << r.counter(PerfCounters::name(e));
+    co << '\n';
+  }
+}
+
+inline int main(int argc, char** argv)
+{
+  std::vector<Result> results;
+  Options cli;
+  parseOptions(cli, argc, argv);
+  CacheMode mode;
+  if (!cacheMode(cli.cache, mode)) {
+    std::cerr << "error: unknown --cache=" << cli.cache
+              << " (warm, flush, thrash, cold or tlb)" << std::endl;
+    return 2;
+  }
+  // before running anything, to fail early on a wrong file name
+  Baseline base;
+  if (!cli.baseline.empty()) {
+    base = Baseline::load(cli.baseline);
+    if (!base.error.empty()) {
+      std::cerr << "error: " << base.error << std::endl;
+      return 2;
+    }
+  }
+  if (cli.counters) {
+    PerfCounters probe;
+    if (!probe.available())
+      std::cout << probe.whyNot() << std::endl;
+  }
+  for (auto const& e : registry()) {
+    if (!cli.filter.empty() && e.name.find(cli.filter) == std::string::npos)
+      continue;
+    Options opt;
+    e.tune(opt);
+    parseOptions(opt, argc, argv);
+    results.push_back(run(e, opt));
+    printResult(std::cout, results.back());
+  }
+  if (cli.roofline)
+    printRoofline(std::cout, results);
+  if (!cli.json.empty()) {
+    std::ofstream out(cli.json);
+    writeJSON(out, results);
+  }
+  if (!cli.csv.empty()) {
+    std::ofstream out(cli.csv);
+    writeCSV(out, results);
+  }
+  if (!cli.baseline.empty()) {
+    Baseline now;
+    now.context = Context::current();
+    for (auto const& r : results)
+      now.results[r.name] = Stored{r.stats.median, r.samples};
+    std::cout << "\ncomparison with " << cli.baseline << std::endl;
+    if (compare(std::cout, base, now, cli.compare) > 0)
+      return 1;
+  }
+  return 0;
+}
+
+} // namespace benchmark
+
+#define BENCHMARK_CONCAT_(a, b) a##b
+#define BENCHMARK_CONCAT(a, b)  BENCHMARK_CONCAT_(a, b)
+#define BENCHMARK(kernel)                                                      \
+  static benchmark::Entry& BENCHMARK_CONCAT(benchmark_entry_, __LINE__) =      \
+      benchmark::registerKernel(#kernel, kernel)
+#define BENCHMARK_MAIN()                                                       \
+  int main(int argc, char** argv)                                              \
+  {                                                                            \
+    return benchmark::main(argc, argv);                                        \
+  }
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef CACHE_OBLIVIOUS_H
+#define CACHE_OBLIVIOUS_H
+//
+//  cache-oblivious matrix multiply and transpose: the largest dimension is
+//  split in two, recursively, down to blocks small enough for a SIMD base
+//  case. At some depth of the recursion the blocks fit in each level of the
+//  cache, whatever its size: no blocking to tune (compare with gemm.h and
+//  gemmTune.h)
+//
+//    oblivious::gemm(m, n, k, 1.f, a, lda, b, ldb, 0.f, c, ldc);
+//    oblivious::gemm(m, n, k, 1.f, a, lda, b, ldb, 0.f, c, ldc, 2);
+//    oblivious::transpose(m, n, a, lda, b, ldb);   // b (n x m) = a^T
+//
+//  the last argument of gemm is the number of levels of Strassen at the top
+//  of the recursion: 7 products of half size instead of 8 (but 18 additions
+//  of quarters, and temporaries), used only while the dimensions are even
+//  and large. It trades some accuracy for fewer flops
+//
+//  row major, as gemm.h
+//
+
+#include "gemm.h"
+#include <algorithm>
+#include <vector>
+
+namespace oblivious {
+
+// the recursion stops when all the dimensions are below these
+constexpr int BaseMM = 64;
+constexpr int BaseTr = 16;
+// Strassen only above
+constexpr int StrassenMin = 256;
+// rows of C in registers in the base case (a divisor of BaseMM)
+constexpr int RowsBase = 8;
+
+// C += alpha A B for a tile of RB rows x CB native vectors of C, held in
+// registers over the whole k loop
+template<typename T, int RB, int CB>
+inline void tile(int k, T alpha, T const* a, int lda, T const* b, int ldb,
+                 T* c, int ldc)
+{
+  using NT        = gemm::Native<T>;
+  using V         = typename NT::V;
+  constexpr int W = NT::size;
+  V acc[RB][CB];
+#pragma GCC unroll 16
+  for (int r = 0; r < RB; ++r)
+#pragma GCC unroll 4
+    for (int v = 0; v < CB; ++v)
+      acc[r][v] = V{} + T(0);
+  for (int p = 0; p < k; ++p) {
+    V bv[CB];
+#pragma GCC unroll 4
+    for (int v = 0; v < CB; ++v)
+      bv[v] = NT::load(b + p * ldb + v * W);
+#pragma GCC unroll 16
+    for (int r = 0; r < RB; ++r) {
+      T ar = a[r * lda + p];
+#pragma GCC unroll 4
+      for (int v = 0; v < CB; ++v)
+        acc[r][v] += ar * bv[v];
+    }
+  }
+#pragma GCC unroll 16
+  for (int r = 0; r < RB; ++r)
+#pragma GCC unroll 4
+    for (int v = 0; v < CB; ++v) {
+      auto pc = c + r * ldc + v * W;
+      NT::store(pc, NT::load(pc) + alpha * acc[r][v]);
+    }
+}
+
+// C += alpha A B on RB rows of a small block: tiles of NV vectors, then of
+// one, then scalar for the last (less than a vector) columns
+template<typename T, int RB>
+inline void rowsKernel(int n, int k, T alpha, T const* a, int lda, T const* b,
+                       int ldb, T* c, int ldc)
+{
+  constexpr int W = gemm::Native<T>::size;
+  int j           = 0;
+  for (; j + gemm::NV * W <= n; j += gemm::NV * W)
+    tile<T, RB, gemm::NV>(k, alpha, a, lda, b + j, ldb, c + j, ldc);
+  for (; j + W <= n; j += W)
+    tile<T, RB, 1>(k, alpha, a, lda, b + j, ldb, c + j, ldc);
+  if (j == n)
+    return;
+  for (int r = 0; r < RB; ++r)
+    for (int p = 0; p < k; ++p) {
+      T ap = alpha * a[r * lda + p];
+      for (int jj = j; jj < n; ++jj)
+        c[r * ldc + jj] += ap * b[p * ldb + jj];
+    }
+}
+
+// C += alpha A B on a small block, directly on the (unpacked) matrices
+template<typename T>
+void baseKernel(int m, int n, int k, T alpha, T const* a, int lda, T const* b,
+                int ldb, T* c, int ldc)
+{
+  int i = 0;
+  for (; i + RowsBase <= m; i += RowsBase)
+    rowsKernel<T, RowsBase>(n, k, alpha, a + i * lda, lda, b, ldb,
+                            c + i * ldc, ldc);
+  for (; i < m; ++i)
+    rowsKernel<T, 1>(n, k, alpha, a + i * lda, lda, b, ldb, c + i * ldc, ldc);
+}
+
+// the half of n, rounded to a multiple of q when possible
+inline int half(int n, int q)
+{
+  int h = (n / 2 + q - 1) / q * q;
+  return h < n ? h : n / 2;
+}
+
+// C += alpha A B
+template<typename T>
+void multiply(int m, int n, int k, T alpha, T const* a, int lda, T const* b,
+              int ldb, T* c, int ldc)
+{
+  if (m <= BaseMM && n <= BaseMM && k <= BaseMM)
+    return baseKernel(m, n, k, alpha, a, lda, b, ldb, c, ldc);
+  if (m >= n && m >= k) {
+    int h = half(m, RowsBase);
+    multiply(h, n, k, alpha, a, lda, b, ldb, c, ldc);
+    multiply(m - h, n, k, alpha, a + h * lda, lda, b, ldb, c + h * ldc, ldc);
+  } else if (n >= k) {
+    int h = half(n, 2 * gemm::Native<T>::size);
+    multiply(m, h, k, alpha, a, lda, b, ldb, c, ldc);
+    multiply(m, n - h, k, alpha, a, lda, b + h, ldb, c + h, ldc);
+  } else {
+    // the two halves of k accumulate on the same C: one after the other
+    int h = half(k, 8);
+    multiply(m, n, h, alpha, a, lda, b, ldb, c, ldc);
+    multiply(m, n, k - h, alpha, a + h, lda, b + h * ldb, ldb, c, ldc);
+  }
+}
+
+// z = x + s y (r x c, z contiguous)
+template<typename T>
+void addTo(int r, int c, T const* x, int ldx, T s, T const* y, int ldy, T* z)
+{
+  for (int i = 0; i < r; ++i)
+    for (int j = 0; j < c; ++j)
+      z[i * c + j] = x[i * ldx + j] + s * y[i * ldy + j];
+}
+
+// z += s x (x contiguous)
+template<typename T>
+void accumulate(int r, int c, T s, T const* x, T* z, int ldz)
+{
+  for (int i = 0; i < r; ++i)
+    for (int j = 0; j < c; ++j)
+      z[i * ldz + j] += s * x[i * c + j];
+}
+
+// C += alpha A B, Strassen for the first levels
+template<typename T>
+void strassen(int m, int n, int k, T alpha, T const* a, int lda, T const* b,
+              int ldb, T* c, int ldc, int levels)
+{
+  if (levels <= 0 || m % 2 || n % 2 || k % 2
+      || std::min({m, n, k}) < StrassenMin)
+    return multiply(m, n, k, alpha, a, lda, b, ldb, c, ldc);
+  int const mh = m / 2, nh = n / 2, kh = k / 2;
+  auto a11 = a, a12 = a + kh, a21 = a + mh * lda, a22 = a21 + kh;
+  auto b11 = b, b12 = b + nh, b21 = b + kh * ldb, b22 = b21 + nh;
+  auto c11 = c, c12 = c + nh, c21 = c + mh * ldc, c22 = c21 + nh;
+  std::vector<T> ta(mh * kh), tb(kh * nh), mm(mh * nh);
+  // mm = x y, for the quarters
+  auto product = [&](T const* x, int ldx, T const* y, int ldy) {
+    std::fill(mm.begin(), mm.end(), T(0));
+    strassen(mh, nh, kh, T(1), x, ldx, y, ldy, mm.data(), nh, levels - 1);
+  };
+  auto to = [&](T s, T* z) { accumulate(mh, nh, s, mm.data(), z, ldc); };
+
+  // M1 = (A11 + A22)(B11 + B22)
+  addTo(mh, kh, a11, lda, T(1), a22, lda, ta.data());
+  addTo(kh, nh, b11, ldb, T(1), b22, ldb, tb.data());
+  product(ta.data(), kh, tb.data(), nh);
+  to(alpha, c11);
+  to(alpha, c22);
+  // M2 = (A21 + A22) B11
+  addTo(mh, kh, a21, lda, T(1), a22, lda, ta.data());
+  product(ta.data(), kh, b11, ldb);
+  to(alpha, c21);
+  to(-alpha, c22);
+  // M3 = A11 (B12 - B22)
+  addTo(kh, nh, b12, ldb, T(-1), b22, ldb, tb.data());
+  product(a11, lda, tb.data(), nh);
+  to(alpha, c12);
+  to(alpha, c22);
+  // M4 = A22 (B21 - B11)
+  addTo(kh, nh, b21, ldb, T(-1), b11, ldb, tb.data());
+  product(a22, lda, tb.data(), nh);
+  to(alpha, c11);
+  to(alpha, c21);
+  // M5 = (A11 + A12) B22
+  addTo(mh, kh, a11, lda, T(1), a12, lda, ta.data());
+  product(ta.data(), kh, b22, ldb);
+  to(-alpha, c11);
+  to(alpha, c12);
+  // M6 = (A21 - A11)(B11 + B12)
+  addTo(mh, kh, a21, lda, T(-1), a11, lda, ta.data());
+  addTo(kh, nh, b11, ldb, T(1), b12, ldb, tb.data());
+  product(ta.data(), kh, tb.data(), nh);
+  to(alpha, c22);
+  // M7 = (A12 - A22)(B21 + B22)
+  addTo(mh, kh, a12, lda, T(-1), a22, lda, ta.data());
+  addTo(kh, nh, b21, ldb, T(1), b22, ldb, tb.data());
+  product(ta.data(), kh, tb.data(), nh);
+  to(alpha, c11);
+}
+
+// C = alpha A B + beta C, as gemm::gemm
+template<typename T>
+void gemm(int m, int n, int k, T alpha, T const* a, int lda, T const* b,
+          int ldb, T beta, T* c, int ldc, int strassenLevels = 0)
+{
+  if (beta != T(1))
+    gemm::scale(m, n, beta, c, ldc);
+  if (k == 0 || alpha == T(0))
+    return;
+  strassen(m, n, k, alpha, a, lda, b, ldb, c, ldc, strassenLevels);
+}
+
+// b (n x m) = a^T (a is m x n)
+template<typename T>
+void transpose(int m, int n, T const* a, int lda, T* b, int ldb)
+{
+  if (m <= BaseTr && n <= BaseTr) {
+    for (int i = 0; i < m; ++i)
+      for (int j = 0; j < n; ++j)
+        b[j * ldb + i] = a[i * lda + j];
+    return;
+  }
+  if (m >= n) {
+    int h = half(m, 8);
+    transpose(h, n, a, lda, b, ldb);
+    transpose(m - h, n, a + h * lda, lda, b + h, ldb);
+  } else {
+    int h = half(n, 8);
+    transpose(m, h, a, lda, b, ldb);
+    transpose(m, n - h, a + h, lda, b + h * ldb, ldb);
+  }
+}
+
+} // namespace oblivious
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef CACHE_STATE_H
+#define CACHE_STATE_H
+//
+//  put the memory hierarchy in a known state before a timed region
+//
+//    warm   : nothing done, the data stay in cache from the previous sample
+//    flush  : clflush every line of the registered working set (nothing
+//             if none is registered)
+//    thrash : read and write a buffer twice the size of the LLC
+//    cold   : flush if a working set is registered, thrash otherwise
+//    tlb    : write one line in each of 16K 4KB pages, evicting the
+//             (second level) TLB; these 1MB of lines also evict part of
+//             the L1 and L2, but not much of the LLC
+//
+//  the equivalent of
+//    auto cs = std::vector<char>(100 * 1000 * 1000);
+//    for (auto& c : cs) c = 'a';
+//  in calib.cpp is "thrash", just sized on the actual host
+//
+//  clflush is x86 only: elsewhere "flush" (and "cold") thrash the LLC
+//
+
+#include <sys/mman.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace benchmark {
+
+// data and unified caches of cpu0 (level, bytes), in increasing level
+inline std::vector<std::pair<int, double>> cacheSizes()
+{
+  std::vector<std::pair<int, double>> res;
+  for (int i = 0; i < 16; ++i) {
+    std::string dir =
+        "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(i) + '/';
+    std::ifstream fl(dir + "level"), ft(dir + "type"), fs(dir + "size");
+    int level;
+    std::string type, size;
+    if (!(fl >> level) || !(ft >> type) || !(fs >> size))
+      break;
+    if (type == "Instruction")
+      continue;
+    double bytes = std::atof(size.c_str());
+    if (size.back() == 'K')
+      bytes *= 1024;
+    else if (size.back() == 'M')
+      bytes *= 1024 * 1024;
+    res.emplace_back(level, bytes);
+  }
+  std::sort(res.begin(), res.end());
+  return res;
+}
+
+inline double llcSize()
+{
+  auto c = cacheSizes();
+  // a reasonable default if sysfs is not there
+  return c.empty() ? 32. * 1024 * 1024 : c.back().second;
+}
+
+enum class CacheMode
+{
+  Warm,
+  Flush,
+  Thrash,
+  Cold,
+  TLB
+};
+
+// false for an unknown name (mode unchanged)
+inline bool cacheMode(std::string const& s, CacheMode& mode)
+{
+  static std::pair<char const*, CacheMode> const names[] = {
+      {"warm", CacheMode::Warm},
+      {"flush", CacheMode::Flush},
+      {"thrash", CacheMode::Thrash},
+      {"cold", CacheMode::Cold},
+      {"tlb", CacheMode::TLB}};
+  for (auto const& n : names)
+    if (s == n.first) {
+      mode = n.second;
+      return true;
+    }
+  return false;
+}
+
+// all the memory operations before it are done
+inline void fence()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_mfence();
+#else
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+#endif
+}
+
+inline void thrashLLC()
+{
+  static std::vector<long long> buf(2 * llcSize() / sizeof(long long));
+  // one write per line is enough to evict whatever was there
+  for (std::size_t i = 0; i < buf.size(); i += 64 / sizeof(long long))
+    ++buf[i];
+  fence();
+}
+
+inline void flush(void const* p, std::size_t bytes)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  auto b = reinterpret_cast<std::uintptr_t>(p) & ~std::uintptr_t(63);
+  auto e = reinterpret_cast<std::uintptr_t>(p) + bytes;
+  for (; b < e; b += 64)
+    _mm_clflush(reinterpret_cast<void const*>(b));
+  fence();
+#else
+  (void)p;
+  (void)bytes;
+  thrashLLC();
+#endif
+}
+
+inline void thrashTLB()
+{
+  // 16K pages: more than the entries of any current STLB
+  constexpr std::size_t page = 4096, npages = 16 * 1024;
+  static char* buf           = [] {
+    auto p = (char*)aligned_alloc(page, page * npages);
+    // small pages only, or the whole buffer would fit in a few TLB entries
+    madvise(p, page * npages, MADV_NOHUGEPAGE);
+    for (std::size_t i = 0; i < page * npages; i += page)
+      p[i] = 0;
+    return p;
+  }();
+  // a different line in each page, not to hit always the same cache set
+  for (std::size_t i = 0; i < npages; ++i)
+    ++buf[i * page + (i % 64) * 64];
+  fence();
+}
+
+// the memory regions a kernel wants to be cold
+class CacheState
+{
+public:
+  void add(void const* p, std::size_t bytes)
+  {
+    regions_.emplace_back(p, bytes);
+  }
+  bool empty() const
+  {
+    return regions_.empty();
+  }
+
+  void prepare(CacheMode mode) const
+  {
+    if (mode == CacheMode::Cold)
+      mode = regions_.empty() ? CacheMode::Thrash : CacheMode::Flush;
+#if !defined(__x86_64__) && !defined(__i386__)
+    // once, not once per region
+    if (mode == CacheMode::Flush)
+      mode = CacheMode::Thrash;
+#endif
+    switch (mode) {
+    case CacheMode::Flush:
+      for (auto const& r : regions_)
+        flush(r.first, r.second);
+      break;
+    case CacheMode::Thrash:
+      thrashLLC();
+      break;
+    case CacheMode::TLB:
+      thrashTLB();
+      break;
+    default:
+      break;
+    }
+  }
+
+private:
+  std::vector<std::pair<void const*, std::size_t>> regions_;
+};
+
+} // namespace benchmark
+
+#endif
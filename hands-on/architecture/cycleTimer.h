@@ -0,0 +1,168 @@
+#ifndef CYCLE_TIMER_H
+#define CYCLE_TIMER_H
+//
+//  a calibrated timer based on the time stamp counter
+//
+//  reads are serialized (lfence;rdtsc;lfence at start, rdtscp;lfence at stop)
+//  so that the region cannot leak out of the measurement, the frequency of
+//  the TSC is calibrated once against steady_clock and the overhead of a
+//  start/stop pair is subtracted:
+//
+//    benchmark::CycleTimer t;
+//    for (...) {
+//      t.start();
+//      ... region ...
+//      t.stop();
+//    }
+//    std::cout << t.ns() / t.count() << " ns per region" << std::endl;
+//
+//  NB: on any recent x86 the TSC is invariant: it ticks at the nominal
+//  frequency, so "cycles" are reference cycles, not core cycles
+//  (for the latter see perfCounters.h)
+//
+//  off x86 there is no TSC: begin() and end() read steady_clock (in ns) and
+//  tsc::available is false, the rest is the same
+//
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace benchmark {
+
+namespace tsc {
+
+#if defined(__x86_64__) || defined(__i386__)
+constexpr bool available = true;
+
+inline __attribute__((always_inline)) uint64_t begin()
+{
+  _mm_lfence();
+  auto t = __rdtsc();
+  _mm_lfence();
+  return t;
+}
+
+inline __attribute__((always_inline)) uint64_t end()
+{
+  unsigned int aux;
+  auto t = __rdtscp(&aux);
+  _mm_lfence();
+  return t;
+}
+#else
+constexpr bool available = false;
+
+inline uint64_t begin()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline uint64_t end()
+{
+  return begin();
+}
+#endif
+
+struct Calibration
+{
+  double ticksPerNs = 1.;
+  double overhead   = 0; // ticks of an empty begin()/end() pair
+
+  Calibration()
+  {
+    using Clock = std::chrono::steady_clock;
+    // median of a few 10 ms busy waits
+    double r[5];
+    for (auto& x : r) {
+      auto t0 = Clock::now();
+      auto c0 = begin();
+      while (Clock::now() - t0 < std::chrono::milliseconds(10))
+        ;
+      auto c1 = end();
+      auto t1 = Clock::now();
+      x = double(c1 - c0)
+        / std::chrono::duration<double, std::nano>(t1 - t0).count();
+    }
+    std::sort(r, r + 5);
+    ticksPerNs = r[2];
+
+    uint64_t best = ~uint64_t(0);
+    for (int i = 0; i < 1000; ++i) {
+      auto c0 = begin();
+      auto c1 = end();
+      best    = std::min(best, c1 - c0);
+    }
+    overhead = best;
+  }
+};
+
+// calibrated once per process
+inline Calibration const& calibration()
+{
+  static const Calibration c;
+  return c;
+}
+
+inline double toNs(double ticks)
+{
+  return ticks / calibration().ticksPerNs;
+}
+
+} // namespace tsc
+
+// accumulates over start/stop pairs
+class CycleTimer
+{
+public:
+  CycleTimer()
+  {
+    tsc::calibration();
+  }
+
+  void reset()
+  {
+    ticks_ = 0;
+    n_     = 0;
+  }
+
+  inline __attribute__((always_inline)) void start()
+  {
+    t0_ = tsc::begin();
+  }
+  inline __attribute__((always_inline)) void stop()
+  {
+    auto t1 = tsc::end();
+    ticks_ += double(t1 - t0_) - tsc::calibration().overhead;
+    ++n_;
+  }
+
+  // number of start/stop pairs
+  long long count() const
+  {
+    return n_;
+  }
+  // reference cycles, overhead subtracted
+  double cycles() const
+  {
+    return std::max(0., ticks_);
+  }
+  double ns() const
+  {
+    return tsc::toNs(cycles());
+  }
+
+private:
+  uint64_t t0_  = 0;
+  double ticks_ = 0;
+  long long n_  = 0;
+};
+
+} // namespace benchmark
+
+#endif
@@ -0,0 +1,494 @@
+#ifndef GEMM_H
+#define GEMM_H
+//
+//  a cache-blocked, register-tiled matrix multiply (the Goto/BLIS scheme)
+//
+//    C = alpha * A * B + beta * C
+//
+//  row major, A is m x k, B is k x n, C is m x n with leading dimensions
+//  lda, ldb, ldc (>= the number of columns):
+//
+//    gemm::gemm(m, n, k, 1.f, a, lda, b, ldb, 1.f, c, ldc);
+//
+//  loops, from the outside in:
+//    jc : nc columns of B and C            (B panel sized for the L3)
+//    pc : kc of the inner dimension        (B packed in NR wide micro-panels)
+//    ic : mc rows of A and C               (A packed in MR high micro-panels,
+//                                           the block sized for the L2)
+//    jr, ir : one MR x NR tile of C        (B micro-panel sized for the L1)
+//  the micro-kernel keeps the MR x NR tile of C in registers and for each of
+//  the kc steps loads NR elements of B, broadcasts MR elements of A and does
+//  MR * NR / W fma (W elements per native vector). Packing makes all its
+//  loads contiguous, and pads the edges with zeros: partial tiles are
+//  computed in full and only the store is partial.
+//
+//  6 x 16 (float) with AVX2: 12 accumulators + 2 for B + 1 broadcast out of
+//  16 registers; with AVX-512 (32 registers) 12 x 32
+//
+//  the multithreaded version (gemm(pool, ...)) splits each block of C in a
+//  2D grid of tiles, one per thread, and shares the packed panels of B
+//
+//  A and B can be stored in a narrower (or just different) type than the
+//  one of the computation, they are converted when packed:
+//
+//    std::vector<_Float16> a, b; std::vector<float> c;   // or gemm::BFloat16
+//    gemm::gemm(m, n, k, 1.f, a.data(), k, b.data(), n, 0.f, c.data(), n);
+//
+//  (half the bytes to read for A and B, the kernel unchanged), or
+//  float A and B with double accumulation and C
+//
+//  the blocking (and the unroll and loop order of the micro and macro
+//  kernels) can be searched on the host and stored, see gemmTune.h
+//
+//  the vector width (and MR) are those of the compilation target, unless
+//  the SSE4, AVX2 or AVX-512 version is chosen at run time with
+//  gemm::dispatched<T>() (see isaDispatch.h)
+//
+
+#include "cacheState.h"
+#include "isaDispatch.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace gemm {
+
+// the widest vector of the compilation target
+#if defined(__AVX512F__)
+constexpr int nativeBytes = 64;
+#elif defined(__AVX__)
+constexpr int nativeBytes = 32;
+#else
+constexpr int nativeBytes = 16;
+#endif
+
+// vectors of VB bytes: all the templates below take VB so that a binary can
+// hold several versions (see dispatched())
+template<typename T, int VB = nativeBytes>
+struct Native
+{
+  static constexpr int bytes = VB;
+  static constexpr int size  = bytes / sizeof(T);
+  typedef T V __attribute__((vector_size(bytes)));
+
+  // unaligned (C, and B when kc is not a multiple of W)
+  static V load(T const* p)
+  {
+    V v;
+    memcpy(&v, p, sizeof(V));
+    return v;
+  }
+  static void store(T* p, V v)
+  {
+    memcpy(p, &v, sizeof(V));
+  }
+};
+
+// bfloat16: the upper half of a float (8 bits of mantissa, the range of a
+// float), only for storage
+struct BFloat16
+{
+  std::uint16_t bits;
+
+  BFloat16() = default;
+  // round to nearest even (NaNs are not preserved)
+  BFloat16(float f)
+  {
+    std::uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    bits = (u + 0x7fff + ((u >> 16) & 1)) >> 16;
+  }
+  operator float() const
+  {
+    std::uint32_t u = std::uint32_t(bits) << 16;
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+  }
+};
+
+// rows of A times vectors of B in the register tile
+template<int VB = nativeBytes>
+constexpr int MR = VB == 64 ? 12 : 6;
+constexpr int NV = 2;
+
+template<typename T, int VB = nativeBytes>
+constexpr int NR = NV * Native<T, VB>::size;
+
+struct Blocking
+{
+  int mc, kc, nc;
+  int ku         = 1;     // unroll of the k loop of the micro-kernel (1, 2, 4)
+  bool rowsOuter = false; // macro-kernel: ir outside jr (A micro-panel reused)
+};
+
+// from the cache sizes of the host: a kc x NR micro-panel of B in the L1
+// (the A micro-panels just stream through it), an mc x kc block of A in half
+// of the L2, kc x nc of B in half of the L3
+template<typename T, int VB = nativeBytes>
+Blocking defaultBlocking()
+{
+  constexpr int MR = gemm::MR<VB>;
+  double l1 = 32 * 1024, l2 = 256 * 1024, l3 = 8 * 1024 * 1024;
+  for (auto const& c : benchmark::cacheSizes()) {
+    if (c.first == 1)
+      l1 = c.second;
+    else if (c.first == 2)
+      l2 = c.second;
+    else
+      l3 = c.second;
+  }
+  Blocking b;
+  b.kc = std::clamp(int(l1 / (NR<T, VB> * sizeof(T))) & ~7, 64, 512);
+  b.mc = std::clamp(int(l2 / (2 * b.kc * sizeof(T))) / MR * MR, MR, 32 * MR);
+  constexpr int nr = NR<T, VB>;
+  b.nc = std::clamp(int(l3 / (2 * b.kc * sizeof(T))) / nr * nr, nr, 256 * nr);
+  return b;
+}
+
+// an aligned buffer that only grows
+template<typename T>
+class Buffer
+{
+public:
+  Buffer()              = default;
+  Buffer(Buffer const&) = delete;
+  Buffer& operator=(Buffer const&) = delete;
+  ~Buffer()
+  {
+    free(p_);
+  }
+
+  T* get(std::size_t n)
+  {
+    if (n > n_) {
+      free(p_);
+      n_ = (n + 63) & ~std::size_t(63);
+      p_ = (T*)aligned_alloc(64, n_ * sizeof(T));
+    }
+    return p_;
+  }
+
+private:
+  T* p_          = nullptr;
+  std::size_t n_ = 0;
+};
+
+// mc x kc block of A in micro-panels of MR rows, scaled by alpha (and
+// converted from the storage type S to the type of the computation T)
+template<typename T, int VB = nativeBytes, typename S = T>
+void packA(int mc, int kc, S const* a, int lda, T alpha, T* pa)
+{
+  constexpr int MR = gemm::MR<VB>;
+  for (int ir = 0; ir < mc; ir += MR)
+    for (int p = 0; p < kc; ++p)
+      for (int i = 0; i < MR; ++i)
+        *pa++ = ir + i < mc ? alpha * T(a[(ir + i) * lda + p]) : T(0);
+}
+
+// kc x nc block of B in micro-panels of NR columns
+template<typename T, int VB = nativeBytes, typename S = T>
+void packB(int kc, int nc, S const* b, int ldb, T* pb)
+{
+  constexpr int nr = NR<T, VB>;
+  for (int jr = 0; jr < nc; jr += nr) {
+    int n = std::min(nr, nc - jr);
+    for (int p = 0; p < kc; ++p) {
+      auto row = b + p * ldb + jr;
+      for (int j = 0; j < n; ++j)
+        pb[j] = T(row[j]);
+      for (int j = n; j < nr; ++j)
+        pb[j] = T(0);
+      pb += nr;
+    }
+  }
+}
+
+// an mr x nr (<= MR x NR) tile of C from a micro-panel of A and one of B,
+// the k loop unrolled KU times
+template<typename T, int VB = nativeBytes, int KU = 1>
+inline void microKernel(int kc, T const* __restrict__ a,
+                        T const* __restrict__ b, T* c, int ldc, T beta,
+                        int mr, int nr)
+{
+  using NT         = Native<T, VB>;
+  using V          = typename NT::V;
+  constexpr int W  = NT::size;
+  constexpr int MR = gemm::MR<VB>;
+  constexpr int NR = NV * W;
+
+  V acc[MR][NV];
+#pragma GCC unroll 16
+  for (int i = 0; i < MR; ++i)
+#pragma GCC unroll 4
+    for (int v = 0; v < NV; ++v)
+      acc[i][v] = V{} + T(0);
+
+  auto step = [&] {
+    V bv[NV];
+#pragma GCC unroll 4
+    for (int v = 0; v < NV; ++v)
+      bv[v] = NT::load(b + v * W);
+#pragma GCC unroll 16
+    for (int i = 0; i < MR; ++i) {
+      T ai = a[i];
+#pragma GCC unroll 4
+      for (int v = 0; v < NV; ++v)
+        acc[i][v] += ai * bv[v];
+    }
+    a += MR;
+    b += NR;
+  };
+  int p = 0;
+  for (; p + KU <= kc; p += KU)
+#pragma GCC unroll 8
+    for (int u = 0; u < KU; ++u)
+      step();
+  for (; p < kc; ++p)
+    step();
+
+  if (mr == MR && nr == NR) {
+#pragma GCC unroll 16
+    for (int i = 0; i < MR; ++i)
+#pragma GCC unroll 4
+      for (int v = 0; v < NV; ++v) {
+        auto pc = c + i * ldc + v * W;
+        // beta = 0: C is not read (it may be uninitialized)
+        NT::store(pc, beta == T(0) ? acc[i][v]
+                                   : beta * NT::load(pc) + acc[i][v]);
+      }
+    return;
+  }
+  alignas(64) T tile[MR][NR];
+  memcpy(tile, acc, sizeof(tile));
+  for (int i = 0; i < mr; ++i)
+    for (int j = 0; j < nr; ++j) {
+      auto& x = c[i * ldc + j];
+      x       = beta == T(0) ? tile[i][j] : beta * x + tile[i][j];
+    }
+}
+
+// an mc x nc block of C from a packed block of A and a packed panel of B
+template<typename T, int VB, int KU>
+void macroLoops(int mc, int nc, int kc, T const* pa, T const* pb, T* c,
+                int ldc, T beta, bool rowsOuter)
+{
+  constexpr int MR = gemm::MR<VB>;
+  constexpr int nr = NR<T, VB>;
+  auto tile        = [&](int ir, int jr) {
+    microKernel<T, VB, KU>(kc, pa + ir * kc, pb + jr * kc, c + ir * ldc + jr,
+                           ldc, beta, std::min(MR, mc - ir),
+                           std::min(nr, nc - jr));
+  };
+  if (rowsOuter) {
+    for (int ir = 0; ir < mc; ir += MR)
+      for (int jr = 0; jr < nc; jr += nr)
+        tile(ir, jr);
+  } else {
+    for (int jr = 0; jr < nc; jr += nr)
+      for (int ir = 0; ir < mc; ir += MR)
+        tile(ir, jr);
+  }
+}
+
+template<typename T, int VB = nativeBytes>
+void macroKernel(int mc, int nc, int kc, T const* pa, T const* pb, T* c,
+                 int ldc, T beta, Blocking const& bl)
+{
+  switch (bl.ku) {
+  case 4:
+    return macroLoops<T, VB, 4>(mc, nc, kc, pa, pb, c, ldc, beta,
+                                bl.rowsOuter);
+  case 2:
+    return macroLoops<T, VB, 2>(mc, nc, kc, pa, pb, c, ldc, beta,
+                                bl.rowsOuter);
+  default:
+    return macroLoops<T, VB, 1>(mc, nc, kc, pa, pb, c, ldc, beta,
+                                bl.rowsOuter);
+  }
+}
+
+// C = beta * C for the trivial cases
+template<typename T>
+void scale(int m, int n, T beta, T* c, int ldc)
+{
+  for (int i = 0; i < m; ++i)
+    for (int j = 0; j < n; ++j)
+      c[i * ldc + j] = beta == T(0) ? T(0) : beta * c[i * ldc + j];
+}
+
+template<typename T, int VB = nativeBytes, typename S = T>
+void gemm(int m, int n, int k, T alpha, S const* a, int lda, S const* b,
+          int ldb, T beta, T* c, int ldc, Blocking const& bl)
+{
+  constexpr int MR = gemm::MR<VB>;
+  constexpr int nr = NR<T, VB>;
+  // one per thread, reused across calls
+  thread_local Buffer<T> bufA, bufB;
+  auto pa = bufA.get(std::size_t(bl.mc + MR) * bl.kc);
+  auto pb = bufB.get(std::size_t(bl.nc + nr) * bl.kc);
+
+  if (k == 0 || alpha == T(0))
+    return scale(m, n, beta, c, ldc);
+  for (int jc = 0; jc < n; jc += bl.nc) {
+    int nc = std::min(bl.nc, n - jc);
+    for (int pc = 0; pc < k; pc += bl.kc) {
+      int kc = std::min(bl.kc, k - pc);
+      packB<T, VB>(kc, nc, b + pc * ldb + jc, ldb, pb);
+      // C is scaled only by the first block of k
+      T bt = pc == 0 ? beta : T(1);
+      for (int ic = 0; ic < m; ic += bl.mc) {
+        int mc = std::min(bl.mc, m - ic);
+        packA<T, VB>(mc, kc, a + ic * lda + pc, lda, alpha, pa);
+        macroKernel<T, VB>(mc, nc, kc, pa, pb, c + ic * ldc + jc, ldc, bt,
+                           bl);
+      }
+    }
+  }
+}
+
+template<typename T, int VB = nativeBytes, typename S = T>
+void gemm(int m, int n, int k, T alpha, S const* a, int lda, S const* b,
+          int ldb, T beta, T* c, int ldc)
+{
+  static const Blocking bl = defaultBlocking<T, VB>();
+  gemm<T, VB>(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, bl);
+}
+
+// rows x columns of threads for an m x n block of C, the tiles as square as
+// possible (fewer columns first: B panels are shared, A blocks are not)
+inline std::pair<int, int> grid(int nThreads, int m, int n)
+{
+  std::pair<int, int> best(nThreads, 1);
+  double bestRatio = 1.e30;
+  for (int r = 1; r <= nThreads; ++r) {
+    if (nThreads % r)
+      continue;
+    int cl       = nThreads / r;
+    double ratio = double(m) / r / (double(n) / cl);
+    ratio        = std::max(ratio, 1. / ratio);
+    if (ratio < bestRatio) {
+      bestRatio = ratio;
+      best      = {r, cl};
+    }
+  }
+  return best;
+}
+
+// the part of one thread of a team of nThreads: all the threads call it
+// with the same arguments, pb is shared and sized as in gemm()
+//
+// for each kc x nc panel of B the threads pack it together (each its share
+// of micro-panels), then each computes its own 2D tile of C, whose
+// boundaries are multiples of MR rows and NR columns: no two threads write
+// the same cache line of C as long as the rows of C are 64 byte aligned
+template<typename T, int VB = nativeBytes, typename S = T>
+void gemmTeam(int tid, int nThreads, benchmark::SpinBarrier& barrier, T* pb,
+              int m, int n, int k, T alpha, S const* a, int lda, S const* b,
+              int ldb, T beta, T* c, int ldc, Blocking const& bl)
+{
+  constexpr int MR = gemm::MR<VB>;
+  constexpr int nr = NR<T, VB>;
+  if (k == 0 || alpha == T(0)) {
+    if (tid == 0)
+      scale(m, n, beta, c, ldc);
+    return;
+  }
+  thread_local Buffer<T> bufA;
+  auto pa = bufA.get(std::size_t(bl.mc + MR) * bl.kc);
+  for (int jc = 0; jc < n; jc += bl.nc) {
+    int nc = std::min(bl.nc, n - jc);
+    // my tile, in units of micro-panels
+    int mPanels = (m + MR - 1) / MR;
+    int nPanels = (nc + nr - 1) / nr;
+    auto g      = grid(nThreads, m, nc);
+    int row     = tid / g.second;
+    int col     = tid % g.second;
+    int i0      = std::min(m, mPanels * row / g.first * MR);
+    int i1      = std::min(m, mPanels * (row + 1) / g.first * MR);
+    int j0      = std::min(nc, nPanels * col / g.second * nr);
+    int j1      = std::min(nc, nPanels * (col + 1) / g.second * nr);
+    // my share of B micro-panels to pack
+    int p0 = std::min(nc, nPanels * tid / nThreads * nr);
+    int p1 = std::min(nc, nPanels * (tid + 1) / nThreads * nr);
+    for (int pc = 0; pc < k; pc += bl.kc) {
+      int kc = std::min(bl.kc, k - pc);
+      if (p1 > p0)
+        packB<T, VB>(kc, p1 - p0, b + pc * ldb + jc + p0, ldb,
+                     pb + p0 * kc);
+      barrier.wait();
+      T bt = pc == 0 ? beta : T(1);
+      for (int ic = i0; ic < i1; ic += bl.mc) {
+        int mc = std::min(bl.mc, i1 - ic);
+        packA<T, VB>(mc, kc, a + ic * lda + pc, lda, alpha, pa);
+        if (j1 > j0)
+          macroKernel<T, VB>(mc, j1 - j0, kc, pa, pb + j0 * kc,
+                             c + ic * ldc + jc + j0, ldc, bt, bl);
+      }
+      // before the panel of B is overwritten
+      barrier.wait();
+    }
+  }
+}
+
+// on all the threads of the pool
+template<typename T, int VB = nativeBytes, typename S = T>
+void gemm(benchmark::ThreadPool& pool, int m, int n, int k, T alpha,
+          S const* a, int lda, S const* b, int ldb, T beta, T* c, int ldc,
+          Blocking const& bl)
+{
+  Buffer<T> bufB;
+  auto pb = bufB.get(std::size_t(bl.nc + NR<T, VB>) * bl.kc);
+  benchmark::SpinBarrier barrier(pool.size());
+  pool.run([&](int tid, int nThreads) {
+    gemmTeam<T, VB>(tid, nThreads, barrier, pb, m, n, k, alpha, a, lda, b,
+                    ldb, beta, c, ldc, bl);
+  });
+}
+
+template<typename T, int VB = nativeBytes, typename S = T>
+void gemm(benchmark::ThreadPool& pool, int m, int n, int k, T alpha,
+          S const* a, int lda, S const* b, int ldb, T beta, T* c, int ldc)
+{
+  static const Blocking bl = defaultBlocking<T, VB>();
+  gemm<T, VB>(pool, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, bl);
+}
+
+// one version per ISA (compile without -march), selected at startup
+template<typename T>
+using Gemm = void (*)(int m, int n, int k, T alpha, T const* a, int lda,
+                      T const* b, int ldb, T beta, T* c, int ldc);
+
+template<typename T>
+ISA_SSE4 void gemmSSE4(int m, int n, int k, T alpha, T const* a, int lda,
+                       T const* b, int ldb, T beta, T* c, int ldc)
+{
+  gemm<T, 16>(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+template<typename T>
+ISA_AVX2 void gemmAVX2(int m, int n, int k, T alpha, T const* a, int lda,
+                       T const* b, int ldb, T beta, T* c, int ldc)
+{
+  gemm<T, 32>(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+template<typename T>
+ISA_AVX512 void gemmAVX512(int m, int n, int k, T alpha, T const* a, int lda,
+                           T const* b, int ldb, T beta, T* c, int ldc)
+{
+  gemm<T, 64>(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+template<typename T>
+Gemm<T> dispatched()
+{
+  static const Gemm<T> f =
+      isa::select(gemmSSE4<T>, gemmAVX2<T>, gemmAVX512<T>);
+  return f;
+}
+
+} // namespace gemm
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef GEMM_TUNE_H
+#define GEMM_TUNE_H
+//
+//  search of the gemm blocking on the current host, stored in a config file
+//  so that the search is done once per machine (type):
+//
+//    auto bl = gemm::tuned<float>("gemmTune.cfg");   // or the default one
+//    gemm::gemm(m, n, k, 1.f, a, lda, b, ldb, 0.f, c, ldc, bl);
+//
+//    bl = gemm::tune<float>(1000, std::cout);       // a few seconds
+//    gemm::save<float>("gemmTune.cfg", bl);
+//
+//  the search is a coordinate descent starting from defaultBlocking(): each
+//  parameter (kc, mc, nc, the unroll of the micro-kernel, the loop order of
+//  the macro-kernel) is varied in turn over a list of candidates keeping the
+//  others fixed, twice. Each candidate is timed as the best of a few square
+//  products (the fleet is noisy, the minimum is the most stable estimate)
+//
+//  the file has one line per host, type and vector width
+//    <cpu model>|L1 L2 L3|<type size>x<vector bytes>\tmc kc nc ku rowsOuter
+//  so that it can be shared by the nodes of a heterogeneous cluster;
+//  a host missing from the file (or with a line that is not valid()) gets
+//  defaultBlocking()
+//
+
+#include "benchBaseline.h"
+#include "benchmark.h"
+#include "gemm.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace gemm {
+
+// what the best blocking depends on
+template<typename T, int VB = nativeBytes>
+std::string hostKey()
+{
+  std::ostringstream key;
+  key << benchmark::Context::cpuinfo("model name") << '|';
+  for (auto const& c : benchmark::cacheSizes())
+    key << (c.first == 1 ? "" : " ") << (long long)c.second;
+  key << '|' << sizeof(T) << 'x' << VB;
+  return key.str();
+}
+
+// the lines of the file for other hosts are kept
+template<typename T, int VB = nativeBytes>
+bool save(std::string const& file, Blocking const& bl)
+{
+  auto key = hostKey<T, VB>();
+  std::vector<std::string> lines;
+  {
+    std::ifstream in(file);
+    std::string line;
+    while (std::getline(in, line))
+      if (line.compare(0, key.size() + 1, key + '\t') != 0)
+        lines.push_back(line);
+  }
+  std::ofstream out(file);
+  for (auto const& l : lines)
+    out << l << '\n';
+  out << key << '\t' << bl.mc << ' ' << bl.kc << ' ' << bl.nc << ' ' << bl.ku
+      << ' ' << bl.rowsOuter << '\n';
+  return bool(out);
+}
+
+// a blocking gemm can run with: positive sizes, mc a multiple of MR, nc of
+// NR, and an unroll the micro-kernel has
+template<typename T, int VB = nativeBytes>
+bool valid(Blocking const& bl)
+{
+  return bl.mc > 0 && bl.kc > 0 && bl.nc > 0 && bl.mc % MR<VB> == 0
+      && bl.nc % NR<T, VB> == 0 && (bl.ku == 1 || bl.ku == 2 || bl.ku == 4);
+}
+
+// false (bl unchanged) if the host is not in the file, or if its line does
+// not parse or is not valid() (then with a message on std::cerr)
+template<typename T, int VB = nativeBytes>
+bool load(std::string const& file, Blocking& bl)
+{
+  auto key = hostKey<T, VB>();
+  std::ifstream in(file);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, key.size() + 1, key + '\t') != 0)
+      continue;
+    std::istringstream ss(line.substr(key.size() + 1));
+    Blocking b;
+    if (ss >> b.mc >> b.kc >> b.nc >> b.ku >> b.rowsOuter && valid<T, VB>(b)) {
+      bl = b;
+      return true;
+    }
+    std::cerr << file << ": invalid blocking for this host, ignored: "
+              << line.substr(key.size() + 1) << std::endl;
+    return false;
+  }
+  return false;
+}
+
+// the stored blocking of this host, or the default one
+template<typename T, int VB = nativeBytes>
+Blocking tuned(std::string const& file)
+{
+  auto bl = defaultBlocking<T, VB>();
+  load<T, VB>(file, bl);
+  return bl;
+}
+
+inline std::ostream& operator<<(std::ostream& co, Blocking const& bl)
+{
+  return co << "mc=" << bl.mc << " kc=" << bl.kc << " nc=" << bl.nc
+            << " ku=" << bl.ku
+            << " order=" << (bl.rowsOuter ? "ir,jr" : "jr,ir");
+}
+
+// the best of reps n x n x n products, in seconds
+template<typename T, int VB = nativeBytes>
+double timeGemm(int n, Blocking const& bl, int reps = 3)
+{
+  std::vector<T> a(std::size_t(n) * n, T(1.3458)), b(a.size(), T(2.467)),
+      c(a.size(), T(0));
+  double best = 1.e30;
+  for (int r = 0; r <= reps; ++r) {
+    auto t0 = std::chrono::steady_clock::now();
+    gemm<T, VB>(n, n, n, T(1), a.data(), n, b.data(), n, T(0), c.data(), n,
+                bl);
+    std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+    benchmark::keep(c);
+    // the first one is a warm up
+    if (r > 0)
+      best = std::min(best, dt.count());
+  }
+  return best;
+}
+
+template<typename T, int VB = nativeBytes>
+Blocking tune(int n, std::ostream& log)
+{
+  constexpr int MR = gemm::MR<VB>;
+  constexpr int nr = NR<T, VB>;
+  auto best        = defaultBlocking<T, VB>();
+  double flops     = 2. * n * n * n;
+  double bestTime  = timeGemm<T, VB>(n, best);
+  log << "default  " << best << "  " << flops / bestTime * 1.e-9
+      << " GFLOP/s" << std::endl;
+
+  auto tryOne = [&](Blocking const& bl) {
+    if (bl.mc == best.mc && bl.kc == best.kc && bl.nc == best.nc
+        && bl.ku == best.ku && bl.rowsOuter == best.rowsOuter)
+      return;
+    double t = timeGemm<T, VB>(n, bl);
+    if (t < bestTime) {
+      bestTime = t;
+      best     = bl;
+      log << "better   " << bl << "  " << flops / t * 1.e-9 << " GFLOP/s"
+          << std::endl;
+    }
+  };
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int kc : {64, 128, 192, 256, 384, 512}) {
+      auto bl = best;
+      bl.kc   = kc;
+      tryOne(bl);
+    }
+    for (int panels : {4, 8, 16, 24, 32, 48}) {
+      auto bl = best;
+      bl.mc   = panels * MR;
+      tryOne(bl);
+    }
+    for (int panels : {16, 32, 64, 128, 256}) {
+      auto bl = best;
+      bl.nc   = panels * nr;
+      tryOne(bl);
+    }
+    for (int ku : {1, 2, 4}) {
+      auto bl = best;
+      bl.ku   = ku;
+      tryOne(bl);
+    }
+    auto bl      = best;
+    bl.rowsOuter = !bl.rowsOuter;
+    tryOne(bl);
+  }
+  log << "best     " << best << "  " << flops / bestTime * 1.e-9 << " GFLOP/s"
+      << std::endl;
+  return best;
+}
+
+} // namespace gemm
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef HOT_COLUMNS_H
+#define HOT_COLUMNS_H
+//
+//  a SoA snapshot of the "hot" data of polymorphic objects: their type and
+//  NCOL values read through accessors, each in its own flat array, so that
+//  the hot loop runs on plain arrays while the objects stay as they are
+//
+//    hot::Snapshot<Base, float, 1> snap(
+//        pa,                                          // Base const* range
+//        [](Base const& b) { return b.type; },        // the type column
+//        {[](Base const& b) { return b.data(); }});   // the value columns
+//    snap.apply<hot::Kind<B, 2>, hot::Kind<C, 3>>(
+//        [](auto k, float x) { return decltype(k)::type::doComp(x); }, out);
+//
+//  apply evaluates the kernel of each kind for all the elements and keeps
+//  the one of their type (a select, not a branch): the loop has no call and
+//  no jump and vectorizes, as long as the kernels are cheap (static, inline,
+//  no side effects). Elements of a type not listed give V(0)
+//
+//  the snapshot is a copy: after some objects change, mark them (by their
+//  position in the range) and refresh() reads only those again, or
+//  refresh(i) at once. extract() reads everything again (objects added or
+//  removed). See Virtual.cpp (USE_SOA)
+//
+
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace hot {
+
+// the C++ type T with type column value ID
+template<typename T, int ID>
+struct Kind
+{
+  using type              = T;
+  static constexpr int id = ID;
+};
+
+template<typename Obj, typename V, int NCOL>
+class Snapshot
+{
+public:
+  using TypeOf = int (*)(Obj const&);
+  using Getter = V (*)(Obj const&);
+
+  template<typename Range>
+  Snapshot(Range const& objs, TypeOf typeOf,
+           std::array<Getter, NCOL> const& get)
+      : typeOf_(typeOf)
+      , get_(get)
+  {
+    extract(objs);
+  }
+
+  // all of them again, from a range of pointers
+  template<typename Range>
+  void extract(Range const& objs)
+  {
+    obj_.assign(std::begin(objs), std::end(objs));
+    type_.resize(obj_.size());
+    for (auto& c : col_)
+      c.resize(obj_.size());
+    for (std::size_t i = 0; i < obj_.size(); ++i)
+      refresh(i);
+    dirty_.clear();
+  }
+
+  void refresh(std::size_t i)
+  {
+    auto const& o = *obj_[i];
+    type_[i]      = typeOf_(o);
+    for (int k = 0; k < NCOL; ++k)
+      col_[k][i] = get_[k](o);
+  }
+
+  // object i has changed (read at the next refresh())
+  void markDirty(std::size_t i)
+  {
+    dirty_.push_back(i);
+  }
+
+  // the objects marked since the last one
+  void refresh()
+  {
+    for (auto i : dirty_)
+      refresh(i);
+    dirty_.clear();
+  }
+
+  std::size_t size() const
+  {
+    return obj_.size();
+  }
+  int const* type() const
+  {
+    return type_.data();
+  }
+  V const* column(int k) const
+  {
+    return col_[k].data();
+  }
+
+  // out[i] = f(Kind{}, column 0 [i], ..., column NCOL-1 [i]) for the Kind of
+  // element i (among K...)
+  template<typename... K, typename F>
+  void apply(F f, V* out) const
+  {
+    apply<K...>(f, out, std::make_index_sequence<NCOL>{});
+  }
+
+private:
+  template<typename... K, typename F, std::size_t... C>
+  void apply(F f, V* __restrict__ out, std::index_sequence<C...>) const
+  {
+    int const* __restrict__ t = type_.data();
+    V const* __restrict__ c[] = {col_[C].data()...};
+    auto n                    = size();
+    for (std::size_t i = 0; i < n; ++i) {
+      V r = V(0);
+      ((r = select(t[i] == K::id, f(K{}, c[C][i]...), r)), ...);
+      out[i] = r;
+    }
+  }
+
+  // both evaluated: no branch in the loop
+  static V select(bool c, V x, V y)
+  {
+    return c ? x : y;
+  }
+
+  TypeOf typeOf_;
+  std::array<Getter, NCOL> get_;
+  std::vector<Obj const*> obj_;
+  std::vector<int> type_;
+  std::array<std::vector<V>, NCOL> col_;
+  std::vector<std::size_t> dirty_;
+};
+
+} // namespace hot
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef ISA_DISPATCH_H
+#define ISA_DISPATCH_H
+//
+//  one binary, several instruction sets: the hot function is compiled once
+//  per ISA and the best one supported by the host is picked at startup
+//
+//    template<typename V>
+//    inline void kernelBody(...) { ... }       // generic (V: vector width)
+//
+//    ISA_SSE4   void kernelSSE4(...)   { kernelBody<float32x4_t>(...); }
+//    ISA_AVX2   void kernelAVX2(...)   { kernelBody<float32x8_t>(...); }
+//    ISA_AVX512 void kernelAVX512(...) { kernelBody<float32x16_t>(...); }
+//
+//    static auto const kernel = isa::select(kernelSSE4, kernelAVX2,
+//                                           kernelAVX512);
+//
+//  the ISA_* macros set the target of the wrapper and "flatten" it: all the
+//  calls inside it are inlined, so that the whole call tree of the body is
+//  compiled for that ISA (a call that is not inlined is compiled for the
+//  ISA of the command line, usually the baseline x86-64)
+//
+//  the choice can be forced (never above what the host supports) with
+//    BENCH_ISA=sse4|avx2|avx512 ./a.out
+//
+//  compile WITHOUT -march=native (or -mavx...): the rest of the program must
+//  run on any of the hosts
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#define ISA_SSE4 __attribute__((target("sse4.2,popcnt"), flatten))
+#define ISA_AVX2 __attribute__((target("avx2,fma,bmi,bmi2,popcnt"), flatten))
+#define ISA_AVX512                                                             \
+  __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma,bmi,"    \
+                        "bmi2,popcnt,prefer-vector-width=512"),                \
+                 flatten))
+
+namespace isa {
+
+enum Level
+{
+  SSE4,
+  AVX2,
+  AVX512,
+  NLevels
+};
+
+inline char const* name(int l)
+{
+  static char const* names[NLevels] = {"sse4", "avx2", "avx512"};
+  return names[l];
+}
+
+// the best supported by the host
+inline Level detect()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+      && __builtin_cpu_supports("avx512dq")
+      && __builtin_cpu_supports("avx512vl"))
+    return AVX512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return AVX2;
+  return SSE4;
+}
+
+inline bool supported(int l)
+{
+  return l <= detect();
+}
+
+// detected, or from BENCH_ISA if supported
+inline Level selected()
+{
+  static const Level l = [] {
+    auto best = detect();
+    auto env  = getenv("BENCH_ISA");
+    if (!env)
+      return best;
+    for (int l = 0; l < NLevels; ++l)
+      if (strcmp(env, name(l)) == 0) {
+        if (l <= best)
+          return Level(l);
+        std::cerr << "BENCH_ISA=" << env << " not supported by this cpu, using "
+                  << name(best) << std::endl;
+        return best;
+      }
+    std::cerr << "unknown BENCH_ISA=" << env << ", using " << name(best)
+              << std::endl;
+    return best;
+  }();
+  return l;
+}
+
+template<typename F>
+F select(F sse4, F avx2, F avx512)
+{
+  switch (selected()) {
+  case AVX512:
+    return avx512;
+  case AVX2:
+    return avx2;
+  default:
+    return sse4;
+  }
+}
+
+} // namespace isa
+
+#endif
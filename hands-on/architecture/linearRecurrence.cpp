@@ -0,0 +1,140 @@
+//
+//  x[i+1] = a[i] x[i] + b[i]: the obvious loop (one multiply-add latency per
+//  element) against the scan of affine maps of linearRecurrence.h, on one
+//  long recurrence and on a batch of short ones
+//
+//  c++ -O2 -march=native -pthread linearRecurrence.cpp
+//  ./a.out --filter=batch
+//
+//  compare ns/item with recurrenceKernel and independentKernel of
+//  pipeline.cpp: how close to the independent loop does the scan get? And
+//  on all the threads?
+//
+#include "benchRunner.h"
+#include "linearRecurrence.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+constexpr std::size_t NLong = 1 << 22;
+// short recurrences (the layers of a detector, the bins of a spectrum...)
+constexpr std::size_t NSteps = 64;
+constexpr std::size_t NBatch = 1 << 11;
+
+benchmark::ThreadPool& pool()
+{
+  static benchmark::ThreadPool p(std::thread::hardware_concurrency());
+  return p;
+}
+
+// an attenuation (a in [0.9, 1)) and a source term
+struct Data
+{
+  std::vector<float> a, b, x;
+
+  explicit Data(std::size_t n)
+      : a(n)
+      , b(n)
+      , x(n + 1)
+  {
+    std::mt19937 eng;
+    std::uniform_real_distribution<float> ra(0.9f, 1.f), rb(0.f, 1.f);
+    for (std::size_t i = 0; i < n; ++i) {
+      a[i] = ra(eng);
+      b[i] = rb(eng);
+    }
+    x[0] = 1.f;
+  }
+};
+
+// largest relative difference from the loop in double
+float maxError(Data const& d, std::size_t n, std::size_t stride)
+{
+  float err = 0;
+  for (std::size_t j = 0; j < stride; ++j) {
+    double x = d.x[j];
+    for (std::size_t i = 0; i < n; ++i) {
+      std::size_t k = i * stride + j;
+      x             = double(d.a[k]) * x + d.b[k];
+      err           = std::max(err, float(std::abs(d.x[k + stride] - x) / x));
+    }
+  }
+  return err;
+}
+
+template<int WHAT>
+void longKernel(benchmark::State& st)
+{
+  Data d(NLong);
+  st.setItems(NLong);
+  st.setBytes(3. * sizeof(float) * NLong);
+  while (st.next()) {
+    if (WHAT == 0)
+      recurrence::serial(NLong, d.a.data(), d.b.data(), d.x.data());
+    else if (WHAT == 1)
+      recurrence::solve(NLong, d.a.data(), d.b.data(), d.x.data());
+    else
+      recurrence::solve(pool(), NLong, d.a.data(), d.b.data(), d.x.data());
+    benchmark::keep(d.x);
+  }
+  char const* what[] = {"serial", "scan", "threaded scan"};
+  std::cout << what[WHAT] << ": max relative error " << maxError(d, NLong, 1)
+            << std::endl;
+}
+
+// one recurrence after the other (each contiguous): serial and scan
+template<bool SCAN>
+void batchOneByOneKernel(benchmark::State& st)
+{
+  Data d(NSteps * NBatch);
+  std::vector<float> x((NSteps + 1) * NBatch);
+  st.setItems(NSteps * NBatch);
+  while (st.next()) {
+    for (std::size_t j = 0; j < NBatch; ++j) {
+      auto a = d.a.data() + j * NSteps, b = d.b.data() + j * NSteps;
+      auto y = x.data() + j * (NSteps + 1);
+      y[0]   = 1.f;
+      if (SCAN)
+        recurrence::solve(NSteps, a, b, y);
+      else
+        recurrence::serial(NSteps, a, b, y);
+    }
+    benchmark::keep(x);
+  }
+}
+
+// one recurrence per lane (step i of all of them contiguous)
+template<bool THREADS>
+void batchLanesKernel(benchmark::State& st)
+{
+  Data d(NSteps * NBatch);
+  std::fill(d.x.begin(), d.x.begin() + NBatch, 1.f);
+  d.x.resize((NSteps + 1) * NBatch);
+  st.setItems(NSteps * NBatch);
+  while (st.next()) {
+    if (THREADS)
+      recurrence::solveBatch(pool(), NSteps, NBatch, d.a.data(), d.b.data(),
+                             d.x.data());
+    else
+      recurrence::solveBatch(NSteps, NBatch, d.a.data(), d.b.data(),
+                             d.x.data());
+    benchmark::keep(d.x);
+  }
+  std::cout << "batch" << (THREADS ? " threaded" : "")
+            << ": max relative error " << maxError(d, NSteps, NBatch)
+            << std::endl;
+}
+
+BENCHMARK(longKernel<0>);
+BENCHMARK(longKernel<1>);
+BENCHMARK(longKernel<2>);
+BENCHMARK(batchOneByOneKernel<false>);
+BENCHMARK(batchOneByOneKernel<true>);
+BENCHMARK(batchLanesKernel<false>);
+BENCHMARK(batchLanesKernel<true>);
+
+BENCHMARK_MAIN()
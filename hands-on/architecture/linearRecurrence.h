@@ -0,0 +1,197 @@
+#ifndef LINEAR_RECURRENCE_H
+#define LINEAR_RECURRENCE_H
+//
+//  first order linear recurrences x[i+1] = a[i] x[i] + b[i] (a cumulative
+//  attenuation, an exponential moving average...) without the loop-carried
+//  dependency of the obvious loop (see recurrenceKernel in pipeline.cpp)
+//
+//    recurrence::solve(n, a, b, x);          // x[1..n] from x[0]
+//    recurrence::solve(pool, n, a, b, x);    // the same on all the threads
+//    recurrence::solveBatch(n, m, a, b, x);  // m independent ones, a[i*m+j]
+//
+//  each step is an affine map f_i(x) = a_i x + b_i and x[i+1] is the
+//  composition f_i o ... o f_0 applied to x[0]. Composition is associative,
+//    (a2, b2) o (a1, b1) = (a2 a1, a2 b1 + b2)
+//  so the prefix compositions are a scan:
+//   - in a native vector, log2(W) steps of shift and multiply-add give the
+//     composed maps of the W lanes; the only dependency left from one
+//     vector to the next is one multiply-add (the value of the last lane)
+//   - across threads, each one first composes the maps of its chunk into a
+//     single one, then (after a barrier) applies those of the chunks before
+//     its own to x[0] and scans its chunk starting from there
+//  the threaded version reads a and b twice
+//
+//  many short recurrences are better done one per SIMD lane, stored so that
+//  step i of all of them is contiguous (a[i*m + j], j the recurrence): the
+//  loop is the obvious one, the lanes give the independent chains
+//
+//  the scan multiplies and adds in a different order than the loop: the
+//  results differ by rounding (small as long as |a| <= 1). It also multiplies
+//  together up to W consecutive a: if they are small the products are
+//  denormals, very slow unless flushed to zero (FTZ/DAZ, or -ffast-math)
+//
+//  b may alias x + 1 (an update in place: x[i+1] += a[i] x[i])
+//
+
+#include "gemm.h"
+#include "prefixScan.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace recurrence {
+
+// the reference: x[i+1] = a[i] x[i] + b[i]
+template<typename T>
+void serial(std::size_t n, T const* a, T const* b, T* x)
+{
+  for (std::size_t i = 0; i < n; ++i)
+    x[i + 1] = a[i] * x[i] + b[i];
+}
+
+// in register: lane l of (va, vb) becomes the composition of the maps of
+// lanes l ... 0
+template<int S = 1, typename V>
+inline void scanMaps(V& va, V& vb)
+{
+  constexpr int W = sizeof(V) / sizeof(va[0]);
+  if constexpr (S < W) {
+    V sa = prefix::shiftUp<S>(va, V{} + 1);
+    V sb = prefix::shiftUp<S>(vb, V{});
+    vb   = va * sb + vb;
+    va   = va * sa;
+    scanMaps<2 * S>(va, vb);
+  }
+}
+
+// out[i] = x after i+1 steps starting from x0
+template<typename T, int VB = gemm::nativeBytes>
+void scan(std::size_t n, T const* a, T const* b, T x0, T* out)
+{
+  using NT        = gemm::Native<T, VB>;
+  using V         = typename NT::V;
+  constexpr int W = NT::size;
+  std::size_t i   = 0;
+  for (; i + W <= n; i += W) {
+    V va = NT::load(a + i), vb = NT::load(b + i);
+    scanMaps(va, vb);
+    V vx = va * x0 + vb;
+    NT::store(out + i, vx);
+    x0 = vx[W - 1];
+  }
+  for (; i < n; ++i)
+    out[i] = x0 = a[i] * x0 + b[i];
+}
+
+// the composition of the n maps (f_n-1 o ... o f_0), as (a, b)
+template<typename T, int VB = gemm::nativeBytes>
+std::pair<T, T> compose(std::size_t n, T const* a, T const* b)
+{
+  using NT        = gemm::Native<T, VB>;
+  using V         = typename NT::V;
+  constexpr int W = NT::size;
+  T ca = 1, cb = 0;
+  std::size_t i = 0;
+  for (; i + W <= n; i += W) {
+    V va = NT::load(a + i), vb = NT::load(b + i);
+    scanMaps(va, vb);
+    cb = va[W - 1] * cb + vb[W - 1];
+    ca = va[W - 1] * ca;
+  }
+  for (; i < n; ++i) {
+    cb = a[i] * cb + b[i];
+    ca = a[i] * ca;
+  }
+  return {ca, cb};
+}
+
+// x[i+1] = a[i] x[i] + b[i], i = 0 ... n-1 (x has n+1 elements)
+template<typename T, int VB = gemm::nativeBytes>
+void solve(std::size_t n, T const* a, T const* b, T* x)
+{
+  scan<T, VB>(n, a, b, x[0], x + 1);
+}
+
+// the same on the threads of the pool, each on a chunk (a multiple of the
+// vector size)
+template<typename T, int VB = gemm::nativeBytes>
+void solve(benchmark::ThreadPool& pool, std::size_t n, T const* a,
+           T const* b, T* x)
+{
+  constexpr std::size_t W = gemm::Native<T, VB>::size;
+  std::vector<std::pair<T, T>> maps(pool.size());
+  pool.run([&](int tid, int nThreads) {
+    auto bound = [&](int t) {
+      return t == nThreads ? n : n * t / nThreads / W * W;
+    };
+    std::size_t lo = bound(tid), hi = bound(tid + 1);
+    maps[tid] = compose<T, VB>(hi - lo, a + lo, b + lo);
+    pool.barrier();
+    // x[lo], from the maps of the chunks before this one
+    T x0 = x[0];
+    for (int t = 0; t < tid; ++t)
+      x0 = maps[t].first * x0 + maps[t].second;
+    scan<T, VB>(hi - lo, a + lo, b + lo, x0, x + 1 + lo);
+  });
+}
+
+// m independent recurrences of n steps, step i of recurrence j in
+// a[i*m + j], b[i*m + j] (x[i*m + j], x has (n+1) m elements): one per lane
+template<typename T, int VB = gemm::nativeBytes>
+void solveBatch(std::size_t n, std::size_t m, T const* a, T const* b, T* x,
+                std::size_t jBegin = 0, std::size_t jEnd = std::size_t(-1))
+{
+  using NT        = gemm::Native<T, VB>;
+  using V         = typename NT::V;
+  constexpr int W = NT::size;
+  constexpr int U = 4; // independent chains in flight, per lane
+  jEnd            = std::min(jEnd, m);
+  std::size_t j   = jBegin;
+  for (; j + U * W <= jEnd; j += U * W) {
+    V vx[U];
+#pragma GCC unroll 4
+    for (int u = 0; u < U; ++u)
+      vx[u] = NT::load(x + j + u * W);
+    for (std::size_t i = 0; i < n; ++i) {
+      std::size_t k = i * m + j;
+#pragma GCC unroll 4
+      for (int u = 0; u < U; ++u) {
+        vx[u] = NT::load(a + k + u * W) * vx[u] + NT::load(b + k + u * W);
+        NT::store(x + k + m + u * W, vx[u]);
+      }
+    }
+  }
+  for (; j + W <= jEnd; j += W) {
+    V vx = NT::load(x + j);
+    for (std::size_t i = 0; i < n; ++i) {
+      std::size_t k = i * m + j;
+      vx            = NT::load(a + k) * vx + NT::load(b + k);
+      NT::store(x + k + m, vx);
+    }
+  }
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t jj = j; jj < jEnd; ++jj) {
+      std::size_t k = i * m + jj;
+      x[k + m]      = a[k] * x[k] + b[k];
+    }
+}
+
+// the same, the recurrences shared among the threads of the pool
+template<typename T, int VB = gemm::nativeBytes>
+void solveBatch(benchmark::ThreadPool& pool, std::size_t n, std::size_t m,
+                T const* a, T const* b, T* x)
+{
+  constexpr std::size_t W = gemm::Native<T, VB>::size;
+  pool.run([&](int tid, int nThreads) {
+    auto bound = [&](int t) {
+      return t == nThreads ? m : m * t / nThreads / W * W;
+    };
+    solveBatch<T, VB>(n, m, a, b, x, bound(tid), bound(tid + 1));
+  });
+}
+
+} // namespace recurrence
+
+#endif
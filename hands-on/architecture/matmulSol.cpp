@@ -1,17 +1,21 @@
 //
 // compile with
 //  c++ -O2 -Wall -fopt-info-vec -march=native matmul.cpp
+//  without -march for the dispatched gemm (mmultGemmDispatch):
+//  c++ -O2 -Wall -Wno-psabi matmulSol.cpp
 //  change -O2 in -Ofast
 //  add -funroll-loops
 //
-//  change order of loops using -DMMULT_ALGO=mmult2
+//  run a single loop order using --filter=mmult2
 //  change N (x2)
 //
-
-#ifndef MMULT_ALGO
-#define MMULT_ALGO mmult
-#warning "using default matmul algorithm"
-#endif
+//  --filter=gemmHalf (gemmBFloat16, gemmDouble): A and B stored in half
+//  precision, or accumulation in double, against gemmFloat (timed anyway
+//  if filtered out) and a long double reference
+//
+//  --tune searches the blocking of gemm on this host and stores it in
+//  gemmTune.cfg (--tune-file=...), later runs read it from there
+//
 
 #ifndef FLOAT
 #define FLOAT float
@@ -83,44 +87,347 @@ FLOAT * alloc(int N) {
 }
 
 
-#include <chrono>
-#include <array>
-#include <iostream>
-#include "benchmark.h"
+#include "benchRunner.h"
+#include "cacheOblivious.h"
+#include "gemm.h"
+#include "gemmTune.h"
+#include <cmath>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
+// the stored one for this host if any (set in main)
+gemm::Blocking blocking = gemm::defaultBlocking<FLOAT>();
 
-int main() {
-  using namespace std;
-  auto start = chrono::high_resolution_clock::now();
+// packed, blocked and register tiled (see gemm.h)
+void mmultGemm(FLOAT const * a, FLOAT const * b, FLOAT * c, int N) {
+  gemm::gemm(N, N, N, FLOAT(1), a, N, b, N, FLOAT(1), c, N, blocking);
+}
 
+// on all the cpus
+void mmultGemmParallel(FLOAT const * a, FLOAT const * b, FLOAT * c, int N) {
+  static benchmark::ThreadPool pool(std::thread::hardware_concurrency());
+  gemm::gemm(pool, N, N, N, FLOAT(1), a, N, b, N, FLOAT(1), c, N, blocking);
+}
 
-  int N = 1000;
-  
-  int size = N*N;
-  FLOAT * a = alloc(size);
-  FLOAT * b = alloc(size);
-  FLOAT * c = alloc(size);
-  
-  init(c,size,0.f);
-  init(a,size,1.3458f);
-  init(b,size,2.467f);
+// SSE4, AVX2 or AVX-512 chosen at run time (BENCH_ISA=... to force one)
+void mmultGemmDispatch(FLOAT const * a, FLOAT const * b, FLOAT * c, int N) {
+  static auto const f = gemm::dispatched<FLOAT>();
+  f(N, N, N, FLOAT(1), a, N, b, N, FLOAT(1), c, N);
+}
+
+// recursive, cache-oblivious (see cacheOblivious.h): nothing to tune
+void mmultRecursive(FLOAT const * a, FLOAT const * b, FLOAT * c, int N) {
+  oblivious::gemm(N, N, N, FLOAT(1), a, N, b, N, FLOAT(1), c, N);
+}
+
+// the same with one level of Strassen on top
+void mmultStrassen(FLOAT const * a, FLOAT const * b, FLOAT * c, int N) {
+  oblivious::gemm(N, N, N, FLOAT(1), a, N, b, N, FLOAT(1), c, N, 1);
+}
+
+constexpr int N = 1000;
+
+template<void (*MMULT)(FLOAT const*, FLOAT const*, FLOAT*, int)>
+void mmultKernel(benchmark::State& st)
+{
+  int size = N * N;
+  FLOAT* a = alloc(size);
+  FLOAT* b = alloc(size);
+  FLOAT* c = alloc(size);
+
+  init(c, size, 0.f);
+  init(a, size, 1.3458f);
+  init(b, size, 2.467f);
 
-  auto delta = start - start;
+  st.setItems(double(N) * N * N);
+  st.setFlops(2. * N * N * N);
+  st.setBytes(4. * size * sizeof(FLOAT), 3. * size * sizeof(FLOAT));
   benchmark::touch(a);
   benchmark::touch(b);
-  delta -= (chrono::high_resolution_clock::now()-start);
-  for (int k=0; k<10; ++k) {
-    MMULT_ALGO(a,b,c,N);
+  while (st.next()) {
+    MMULT(a, b, c, N);
     benchmark::keep(c);
   }
-  delta += (chrono::high_resolution_clock::now()-start);
-  std::cout << " Computation took "
-              << chrono::duration_cast<chrono::milliseconds>(delta).count()
-              << " ms" << std::endl;
 
   // mdiv2(a,b,c,N);
 
-  return c[N];
-  
+  delete[] a;
+  delete[] b;
+  delete[] c;
+}
+
+BENCHMARK(mmultKernel<mmult>).maxReps(20);
+BENCHMARK(mmultKernel<mmult1>).maxReps(20);
+BENCHMARK(mmultKernel<mmult2>).maxReps(20);
+BENCHMARK(mmultKernel<mmultGemm>).maxReps(100);
+BENCHMARK(mmultKernel<mmultGemmParallel>).maxReps(100);
+BENCHMARK(mmultKernel<mmultGemmDispatch>).maxReps(100);
+BENCHMARK(mmultKernel<mmultRecursive>).maxReps(100);
+BENCHMARK(mmultKernel<mmultStrassen>).maxReps(100);
+
+// row by row (one of the two strided) against recursive
+template<bool RECURSIVE>
+void transposeKernel(benchmark::State& st)
+{
+  int size = N * N;
+  FLOAT* a = alloc(size);
+  FLOAT* b = alloc(size);
+  init(a, size, 1.3458f);
+  init(b, size, 0.f);
+
+  st.setItems(size);
+  st.setBytes(2. * size * sizeof(FLOAT));
+  while (st.next()) {
+    if (RECURSIVE)
+      oblivious::transpose(N, N, a, N, b, N);
+    else
+      for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j)
+          b[j * N + i] = a[i * N + j];
+    benchmark::keep(b);
+  }
+
+  delete[] a;
+  delete[] b;
+}
+BENCHMARK(transposeKernel<false>);
+BENCHMARK(transposeKernel<true>);
+
+// non square, and with leading dimensions larger than the rows
+void gemmShapeKernel(benchmark::State& st)
+{
+  int const m = 1500, n = 700, k = 2000;
+  int const lda = k + 16, ldb = n + 8, ldc = n + 24;
+  std::vector<FLOAT> a(m * lda, 1.3458f), b(k * ldb, 2.467f), c(m * ldc, 0);
+
+  st.setItems(double(m) * n * k);
+  st.setFlops(2. * m * n * k);
+  st.setBytes(sizeof(FLOAT) * (double(m) * k + double(k) * n + 2. * m * n));
+  while (st.next()) {
+    gemm::gemm(m, n, k, FLOAT(1), a.data(), lda, b.data(), ldb, FLOAT(0),
+               c.data(), ldc, blocking);
+    benchmark::keep(c);
+  }
 }
+BENCHMARK(gemmShapeKernel).maxReps(100);
 
+// the inputs of the mixed precision kernels, and the reference product
+// computed independently of gemm (naive loop in long double) on every
+// RSTEP-th row, with sum |a b| to normalize the error
+struct MixedInputs
+{
+  static constexpr int RSTEP = 10;
+  std::vector<float> a, b;
+  std::vector<long double> ref, norm; // rows 0, RSTEP, 2 RSTEP...
+
+  MixedInputs()
+      : a(N * N)
+      , b(N * N)
+  {
+    std::mt19937 eng;
+    std::uniform_real_distribution<float> rgen(-1.f, 1.f);
+    for (auto& x : a)
+      x = rgen(eng);
+    for (auto& x : b)
+      x = rgen(eng);
+    for (int i = 0; i < N; i += RSTEP) {
+      std::vector<long double> r(N, 0), s(N, 0);
+      for (int k = 0; k < N; ++k) {
+        long double x = a[i * N + k];
+        for (int j = 0; j < N; ++j) {
+          long double p = x * b[k * N + j];
+          r[j] += p;
+          s[j] += std::abs(p);
+        }
+      }
+      ref.insert(ref.end(), r.begin(), r.end());
+      norm.insert(norm.end(), s.begin(), s.end());
+    }
+  }
+
+  static MixedInputs const& get()
+  {
+    static MixedInputs const in;
+    return in;
+  }
+};
+
+// the median time of gemm with float storage and accumulation: from
+// gemmFloat if it ran before, otherwise timed here, so that the speedup is
+// printed also for --filter=gemmHalf
+double floatTime = 0;
+
+double floatGemmTime()
+{
+  if (floatTime > 0)
+    return floatTime;
+  auto const& in = MixedInputs::get();
+  std::vector<float> c(N * N);
+  std::vector<double> t;
+  for (int r = 0; r < 5; ++r) {
+    auto t0 = benchmark::State::Clock::now();
+    gemm::gemm(N, N, N, 1.f, in.a.data(), N, in.b.data(), N, 0.f, c.data(),
+               N);
+    benchmark::keep(c);
+    t.push_back(std::chrono::duration<double, std::nano>(
+                    benchmark::State::Clock::now() - t0)
+                    .count());
+  }
+  floatTime = benchmark::Stats::compute(t, 5.).median;
+  return floatTime;
+}
+
+// A and B stored as S, accumulated (and C stored) as T: the error is
+// against the long double reference of the same float inputs, the speedup
+// against float storage and accumulation
+template<typename S, typename T>
+void mixedKernel(benchmark::State& st, char const* what)
+{
+  auto const& in = MixedInputs::get();
+  std::vector<S> a(in.a.begin(), in.a.end()), b(in.b.begin(), in.b.end());
+  std::vector<T> c(N * N);
+
+  st.setItems(double(N) * N * N);
+  st.setFlops(2. * N * N * N);
+  st.setBytes(2. * N * N * sizeof(S) + N * N * sizeof(T));
+  while (st.next()) {
+    gemm::gemm(N, N, N, T(1), a.data(), N, b.data(), N, T(0), c.data(), N);
+    benchmark::keep(c);
+  }
+
+  double maxErr = 0;
+  for (int i = 0, r = 0; i < N; i += MixedInputs::RSTEP, ++r)
+    for (int j = 0; j < N; ++j)
+      maxErr = std::max(maxErr,
+                        double(std::abs(c[i * N + j] - in.ref[r * N + j])
+                               / in.norm[r * N + j]));
+
+  double t = benchmark::Stats::compute(st.samples(), 5.).median;
+  if (floatTime == 0 && std::is_same<S, float>::value
+      && std::is_same<T, float>::value)
+    floatTime = t;
+  std::cout << what << ": max error relative to sum |a b| " << maxErr
+            << ", speedup over float " << floatGemmTime() / t << std::endl;
+}
+
+void gemmFloat(benchmark::State& st)
+{
+  mixedKernel<float, float>(st, "float");
+}
+void gemmHalf(benchmark::State& st)
+{
+  mixedKernel<_Float16, float>(st, "_Float16 storage, float accumulation");
+}
+void gemmBFloat16(benchmark::State& st)
+{
+  mixedKernel<gemm::BFloat16, float>(st,
+                                     "bfloat16 storage, float accumulation");
+}
+void gemmDouble(benchmark::State& st)
+{
+  mixedKernel<float, double>(st, "float storage, double accumulation");
+}
+BENCHMARK(gemmFloat).maxReps(100);
+BENCHMARK(gemmHalf).maxReps(100);
+BENCHMARK(gemmBFloat16).maxReps(100);
+BENCHMARK(gemmDouble).maxReps(100);
+
+// against the naive loop, on odd shapes exercising all the edges
+template<typename F>
+bool check(char const* what, F gemmFn)
+{
+  // (the last one large and even enough for a level of Strassen)
+  int const shapes[][3] = {{1, 1, 1},      {7, 13, 5},     {37, 101, 300},
+                           {250, 67, 1030}, {512, 300, 260}};
+  bool ok = true;
+  for (auto const& s : shapes) {
+    int m = s[0], n = s[1], k = s[2];
+    int lda = k + 3, ldb = n + 5, ldc = n + 1;
+    std::vector<FLOAT> a(m * lda), b(k * ldb), c(m * ldc), r(m * ldc);
+    for (int i = 0; i < m * lda; ++i)
+      a[i] = FLOAT(1) / (1 + i % 17);
+    for (int i = 0; i < k * ldb; ++i)
+      b[i] = FLOAT(i % 11) - 5;
+    for (int i = 0; i < m * ldc; ++i)
+      c[i] = r[i] = FLOAT(i % 3);
+    gemmFn(m, n, k, FLOAT(2), a.data(), lda, b.data(), ldb, FLOAT(0.5),
+           c.data(), ldc);
+    double maxErr = 0;
+    for (int i = 0; i < m; ++i)
+      for (int j = 0; j < n; ++j) {
+        double x = 0, norm = 0;
+        for (int p = 0; p < k; ++p) {
+          x += double(a[i * lda + p]) * b[p * ldb + j];
+          norm += std::abs(double(a[i * lda + p]) * b[p * ldb + j]);
+        }
+        x = 2 * x + 0.5 * r[i * ldc + j];
+        maxErr = std::max(maxErr, std::abs(c[i * ldc + j] - x) / (norm + 1));
+      }
+    bool good = maxErr < 1.e-5;
+    ok        = ok && good;
+    std::cout << what << ' ' << m << 'x' << n << 'x' << k << " max rel error "
+              << maxErr << (good ? "" : "  FAILED") << std::endl;
+  }
+  return ok;
+}
+
+// oblivious::transpose against the loop: exact, and the padding of b (up to
+// ldb) untouched
+bool checkTranspose()
+{
+  int const shapes[][2] = {{1, 1},    {7, 13},   {16, 17},
+                           {37, 101}, {250, 67}, {300, 1030}};
+  bool ok = true;
+  for (auto const& s : shapes) {
+    int m = s[0], n = s[1];
+    int lda = n + 3, ldb = m + 5;
+    std::vector<FLOAT> a(m * lda), b(n * ldb, FLOAT(-1));
+    for (int i = 0; i < m * lda; ++i)
+      a[i] = FLOAT(i);
+    oblivious::transpose(m, n, a.data(), lda, b.data(), ldb);
+    int bad = 0;
+    for (int j = 0; j < n; ++j)
+      for (int i = 0; i < ldb; ++i)
+        bad += b[j * ldb + i] != (i < m ? a[i * lda + j] : FLOAT(-1));
+    ok = ok && bad == 0;
+    std::cout << "transpose " << m << 'x' << n << ' ' << bad
+              << " wrong elements" << (bad ? "  FAILED" : "") << std::endl;
+  }
+  return ok;
+}
+
+int main(int argc, char** argv)
+{
+  std::string tuneFile = "gemmTune.cfg";
+  bool tune            = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string a = argv[i];
+    if (a == "--tune")
+      tune = true;
+    else if (a.compare(0, 12, "--tune-file=") == 0)
+      tuneFile = a.substr(12);
+  }
+  if (tune) {
+    blocking = gemm::tune<FLOAT>(N, std::cout);
+    if (!gemm::save<FLOAT>(tuneFile, blocking))
+      std::cerr << "cannot write " << tuneFile << std::endl;
+  } else if (gemm::load<FLOAT>(tuneFile, blocking)) {
+    std::cout << "gemm blocking from " << tuneFile << ": " << blocking
+              << std::endl;
+  }
+
+  benchmark::ThreadPool pool(std::max(2U, std::thread::hardware_concurrency()));
+  auto parallel = [&](auto... args) { gemm::gemm(pool, args..., blocking); };
+  auto native   = [](auto... args) { gemm::gemm(args..., blocking); };
+  auto rec      = [](auto... args) { oblivious::gemm(args...); };
+  auto str      = [](auto... args) { oblivious::gemm(args..., 2); };
+  std::cout << "dispatched gemm: " << isa::name(isa::selected()) << std::endl;
+  if (!check("gemm", native) || !check("parallel gemm", parallel)
+      || !check("dispatched gemm", gemm::dispatched<FLOAT>())
+      || !check("recursive gemm", rec) || !check("strassen gemm", str)
+      || !checkTranspose())
+    return 1;
+  return benchmark::main(argc, argv);
+}
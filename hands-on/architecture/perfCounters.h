@@ -0,0 +1,229 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+//
+//  in-process hardware counters using perf_event_open
+//
+//  contrary to "perf stat ./a.out" (see doPerf) only the region between
+//  start()/stop() (or resume()/pause()) is counted, user space only:
+//
+//    benchmark::PerfCounters pc;
+//    pc.start();
+//    ... timed region ...
+//    benchmark::keep(x);
+//    pc.stop();
+//    pc.report(std::cout, nElements);
+//
+//  all events are read as a single group so that ratios (IPC...) are
+//  consistent. Events not supported by the PMU are just skipped.
+//  If perf_event_paranoid (or the lack of a PMU, as in many VMs) forbids
+//  access available() is false and all values are zero.
+//
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace benchmark {
+
+class PerfCounters
+{
+public:
+  enum Event
+  {
+    Cycles,
+    Instructions,
+    BranchMisses,
+    L1DMisses,
+    LLCMisses,
+    StalledFrontend,
+    StalledBackend,
+    NEvents
+  };
+
+  static char const* name(int e)
+  {
+    static char const* names[NEvents] = {
+        "cycles",     "instructions",     "branch-misses",  "L1D-misses",
+        "LLC-misses", "stalled-frontend", "stalled-backend"};
+    return names[e];
+  }
+
+  PerfCounters()
+  {
+    for (auto& f : fd_)
+      f = -1;
+    constexpr auto cache = [](uint64_t id) {
+      return id | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+           | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+    struct
+    {
+      uint32_t type;
+      uint64_t config;
+    } const events[NEvents] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D)},
+        {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND}};
+
+    for (int e = 0; e < NEvents; ++e) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size           = sizeof(attr);
+      attr.type           = events[e].type;
+      attr.config         = events[e].config;
+      attr.disabled       = fd_[0] < 0; // only the leader
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_ID
+                       | PERF_FORMAT_TOTAL_TIME_ENABLED
+                       | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      int fd = syscall(__NR_perf_event_open, &attr, 0, -1, fd_[0], 0);
+      if (fd < 0) {
+        if (e == Cycles) {
+          errno_ = errno;
+          break; // no leader, no counters
+        }
+        continue;
+      }
+      fd_[e] = fd;
+      ioctl(fd, PERF_EVENT_IOC_ID, &id_[e]);
+    }
+  }
+
+  ~PerfCounters()
+  {
+    for (auto f : fd_)
+      if (f >= 0)
+        close(f);
+  }
+
+  PerfCounters(PerfCounters const&) = delete;
+  PerfCounters& operator=(PerfCounters const&) = delete;
+
+  bool available() const
+  {
+    return fd_[0] >= 0;
+  }
+  bool has(int e) const
+  {
+    return fd_[e] >= 0;
+  }
+
+  // one line explaining why there are no counters
+  std::string whyNot() const
+  {
+    std::string msg = "hardware counters not available (";
+    std::ifstream in("/proc/sys/kernel/perf_event_paranoid");
+    int level = 0;
+    if ((errno_ == EACCES || errno_ == EPERM) && (in >> level))
+      msg += "perf_event_paranoid=" + std::to_string(level);
+    else
+      msg += strerror(errno_);
+    return msg + "), timing only";
+  }
+
+  void reset()
+  {
+    ctl(PERF_EVENT_IOC_RESET);
+  }
+  void resume()
+  {
+    ctl(PERF_EVENT_IOC_ENABLE);
+  }
+  void pause()
+  {
+    ctl(PERF_EVENT_IOC_DISABLE);
+  }
+  void start()
+  {
+    reset();
+    resume();
+  }
+  void stop()
+  {
+    pause();
+    read();
+  }
+
+  // values are scaled for multiplexing
+  void read()
+  {
+    for (auto& v : value_)
+      v = 0;
+    if (!available())
+      return;
+    struct
+    {
+      uint64_t nr, enabled, running;
+      struct
+      {
+        uint64_t value, id;
+      } v[NEvents];
+    } buf;
+    if (::read(fd_[0], &buf, sizeof(buf)) <= 0 || buf.running == 0)
+      return;
+    double scale = double(buf.enabled) / double(buf.running);
+    for (auto i = 0U; i < buf.nr; ++i)
+      for (int e = 0; e < NEvents; ++e)
+        if (has(e) && id_[e] == buf.v[i].id)
+          value_[e] = scale * buf.v[i].value;
+  }
+
+  double value(int e) const
+  {
+    return value_[e];
+  }
+
+  // per element values are printed if n>0
+  void report(std::ostream& co, double n = 0) const
+  {
+    if (!available()) {
+      co << whyNot() << std::endl;
+      return;
+    }
+    char buf[128];
+    if (value_[Cycles] > 0) {
+      snprintf(buf, sizeof(buf), "IPC %.3f",
+               value_[Instructions] / value_[Cycles]);
+      co << buf;
+    }
+    for (int e = 0; e < NEvents; ++e) {
+      if (!has(e))
+        continue;
+      if (n > 0)
+        snprintf(buf, sizeof(buf), "  %s/item %.4g", name(e), value_[e] / n);
+      else
+        snprintf(buf, sizeof(buf), "  %s %.4g", name(e), value_[e]);
+      co << buf;
+    }
+    co << std::endl;
+  }
+
+private:
+  void ctl(unsigned long request)
+  {
+    if (available())
+      ioctl(fd_[0], request, PERF_IOC_FLAG_GROUP);
+  }
+
+  int fd_[NEvents];
+  int errno_             = 0;
+  uint64_t id_[NEvents]  = {0};
+  double value_[NEvents] = {0};
+};
+
+} // namespace benchmark
+
+#endif
@@ -1,7 +1,8 @@
-#include <chrono>
 #include <array>
 #include <iostream>
-#include "benchmark.h"
+#include <xmmintrin.h>
+#include "benchRunner.h"
+#include "linearRecurrence.h"
 
 inline
 size_t
@@ -19,93 +20,115 @@ double perform_computation(int w) {
   return fib(w);
 }
 
-int main()
+void fibKernel(benchmark::State& st)
 {
-    using namespace std;
-    auto start = chrono::high_resolution_clock::now();
-   auto delta = start - start;
     int value = 42;
+    double answer = 0;
+    while (st.next()) {
     benchmark::touch(value);
-    double answer = perform_computation(value);
+    answer = perform_computation(value);
     benchmark::keep(answer);
-    delta = chrono::high_resolution_clock::now() - start;
-    std::cout << "Answer: " << answer << ". Computation took "
-              << chrono::duration_cast<chrono::milliseconds>(delta).count()
-              << " ms" << std::endl;
+    }
+    std::cout << "Answer: " << answer << std::endl;
+}
 
+constexpr int N=1025;
 
-    constexpr int N=1025;
+void independentKernel(benchmark::State& st)
+{
     std::array<float,N> x,y,z;
 
-
     benchmark::touch(x);
     benchmark::touch(y);
     benchmark::touch(z);
     for (int i=0; i<N; ++i)
        z[i]=y[i]=x[i]=i*1.e-6;
     benchmark::keep(z);
-  
-
 
-    delta = start - start;
-    for (int j=0; j<1000000; ++j) {
-    delta -= (chrono::high_resolution_clock::now()-start);
+    st.setItems(N-1);
+    while (st.next()) {
     benchmark::touch(x);
     benchmark::touch(y);
     benchmark::touch(z);
     for (int i=0; i<N-1; ++i)
        z[i]+=y[i]*x[i];
     benchmark::keep(z);
-    delta += (chrono::high_resolution_clock::now()-start);
     }
-    std::cout << z[N-1] << " Computation took "
-              << chrono::duration_cast<chrono::milliseconds>(delta).count()
-              << " ms" << std::endl;
-
-   for (int i=0; i<N-1; ++i)
-       z[i]=y[i]=x[i]=i*1.e-6;
+    std::cout << z[N-1] << std::endl;
+}
 
+void recurrenceKernel(benchmark::State& st)
+{
+    std::array<float,N> x,y,z;
 
-    delta = start - start;
-    for (int j=0; j<1000000; ++j) {
+    st.setItems(N-1);
+    while (st.next()) {
+    st.pause();
    for (int i=0; i<N; ++i)
-       z[i]=y[i]=x[i]=i*1.e-6;                                                                          
-    delta -= (chrono::high_resolution_clock::now()-start);
+       z[i]=y[i]=x[i]=i*1.e-6;
+    st.resume();
     benchmark::touch(x);
     benchmark::touch(y);
     benchmark::touch(z);
     for (int i=0; i<N-1; ++i)
        z[i+1]+=y[i]*z[i];
     benchmark::keep(z);
-    delta += (chrono::high_resolution_clock::now()-start);
     }
-    std::cout << z[N-1]<<" Computation took "
-              << chrono::duration_cast<chrono::milliseconds>(delta).count()
-              << " ms" << std::endl;
+    std::cout << z[N-1] << std::endl;
+}
+
+// the same recurrence, z[i+1] = y[i]*z[i] + z[i+1], as a scan of affine maps
+// the scan multiplies together up to a vector of y (1.e-6...): denormals,
+// unless they are flushed to zero (try without)
+void scanKernel(benchmark::State& st)
+{
+    std::array<float,N> x,y,z;
+    auto csr = _mm_getcsr();
+    _mm_setcsr(csr | 0x8040);  // FTZ and DAZ
+
+    st.setItems(N-1);
+    while (st.next()) {
+    st.pause();
+   for (int i=0; i<N; ++i)
+       z[i]=y[i]=x[i]=i*1.e-6;
+    st.resume();
+    benchmark::touch(x);
+    benchmark::touch(y);
+    benchmark::touch(z);
+    recurrence::solve(N-1, y.data(), z.data()+1, z.data());
+    benchmark::keep(z);
+    }
+    _mm_setcsr(csr);
+    std::cout << z[N-1] << std::endl;
+}
+
+void inplaceKernel(benchmark::State& st)
+{
+    std::array<float,N> x,y,z;
 
    for (int i=0; i<N; ++i)
        z[i]=y[i]=x[i]=i*1.e-6;
 
-   delta = start - start;
-    for (int j=0; j<1000000; ++j) {
+    st.setItems(N-1);
+    while (st.next()) {
+    st.pause();
    for (int i=0; i<N-1; ++i)
-       z[i]=y[i]=x[i]=i*1.e-6;                                                                          
-    delta -= (chrono::high_resolution_clock::now()-start);
+       z[i]=y[i]=x[i]=i*1.e-6;
+    st.resume();
     benchmark::touch(x);
     benchmark::touch(y);
     benchmark::touch(z);
     for (int i=0; i<N-1; ++i)
        z[i]+=y[i]*z[i];
     benchmark::keep(z);
-    delta += (chrono::high_resolution_clock::now()-start);
     }
-    std::cout<< z[N-1] <<" Computation took "
-              << chrono::duration_cast<chrono::milliseconds>(delta).count()
-              << " ms" << std::endl;
-
-
-
-
-    return 0;
+    std::cout << z[N-1] << std::endl;
 }
 
+BENCHMARK(fibKernel).warmup(1).maxReps(10);
+BENCHMARK(independentKernel);
+BENCHMARK(recurrenceKernel);
+BENCHMARK(scanKernel);
+BENCHMARK(inplaceKernel);
+
+BENCHMARK_MAIN()
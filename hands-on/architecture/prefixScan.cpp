@@ -0,0 +1,156 @@
+//
+//  prefix sums: std::inclusive_scan (sequential and std::execution::par)
+//  against the SIMD and multithreaded scans of prefixScan.h, on ints (the
+//  offsets of a CSR matrix) and on floats (the CDF of a histogram)
+//
+//  c++ -O2 -march=native -pthread prefixScan.cpp -ltbb
+//  (without TBB the std::execution::par version is not built)
+//
+//  is the scan limited by the memory bandwidth (compare with --roofline of
+//  roofline.cpp)? How far is the sequential loop from it?
+//
+#include "benchRunner.h"
+#include "prefixScan.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if __has_include(<tbb/version.h>) && __has_include(<execution>)
+#  include <execution>
+#  define HAVE_PAR 1
+#endif
+
+constexpr std::size_t N = 1 << 24;
+
+benchmark::ThreadPool& pool()
+{
+  static benchmark::ThreadPool p(std::thread::hardware_concurrency());
+  return p;
+}
+
+// row lengths of a sparse matrix, or bin contents
+template<typename T>
+std::vector<T> input(std::size_t n)
+{
+  std::mt19937 eng;
+  std::uniform_int_distribution<int> rgen(0, 32);
+  std::vector<T> v(n);
+  for (auto& x : v)
+    x = rgen(eng);
+  return v;
+}
+
+enum What { Std, StdPar, Simd, Threads };
+
+template<typename T, What WHAT>
+void inclusiveKernel(benchmark::State& st)
+{
+  auto in = input<T>(N);
+  std::vector<T> out(N);
+  st.setItems(N);
+  st.setBytes(2. * sizeof(T) * N);
+  while (st.next()) {
+    if constexpr (WHAT == Std)
+      std::inclusive_scan(in.begin(), in.end(), out.begin());
+#ifdef HAVE_PAR
+    else if constexpr (WHAT == StdPar)
+      std::inclusive_scan(std::execution::par, in.begin(), in.end(),
+                          out.begin());
+#endif
+    else if constexpr (WHAT == Simd)
+      prefix::inclusive(N, in.data(), out.data());
+    else
+      prefix::inclusive(pool(), N, in.data(), out.data());
+    benchmark::keep(out);
+  }
+}
+
+template<What WHAT>
+void intScan(benchmark::State& st)
+{
+  inclusiveKernel<int, WHAT>(st);
+}
+template<What WHAT>
+void floatScan(benchmark::State& st)
+{
+  inclusiveKernel<float, WHAT>(st);
+}
+
+// against the loop in double (exact for the ints)
+template<typename T, typename F>
+bool check(char const* what, F scanFn)
+{
+  bool ok = true;
+  for (std::size_t n : {0, 1, 7, 100, 1000, 3 << 16, 1 << 20}) {
+    auto in = input<T>(n);
+    std::vector<T> out(n), excl(n), mx(n);
+    scanFn(n, in.data(), out.data(), excl.data(), mx.data());
+    double s = 0, err = 0;
+    T m      = std::numeric_limits<T>::lowest();
+    for (std::size_t i = 0; i < n; ++i) {
+      err = std::max(err, std::abs(excl[i] - s) / std::max(s, 1.));
+      s += in[i];
+      m   = std::max(m, in[i]);
+      err = std::max(err, std::abs(out[i] - s) / s);
+      if (mx[i] != m)
+        err = 1;
+    }
+    if (err > (std::is_integral_v<T> ? 0 : 1.e-6)) {
+      std::cout << what << ' ' << n << ": max relative error " << err
+                << std::endl;
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+template<typename T>
+bool checkAll()
+{
+  auto simd = [](std::size_t n, T const* in, T* out, T* excl, T* mx) {
+    prefix::inclusive(n, in, out);
+    prefix::exclusive(n, in, excl, T(0));
+    prefix::inclusive(n, in, mx, prefix::Max{});
+  };
+  auto threads = [](std::size_t n, T const* in, T* out, T* excl, T* mx) {
+    prefix::inclusive(pool(), n, in, out);
+    prefix::exclusive(pool(), n, in, excl, T(0));
+    prefix::inclusive(pool(), n, in, mx, prefix::Max{});
+  };
+  // in place
+  auto inPlace = [](std::size_t n, T const* in, T* out, T* excl, T* mx) {
+    std::copy(in, in + n, out);
+    prefix::inclusive(pool(), n, out, out);
+    std::copy(in, in + n, excl);
+    prefix::exclusive(n, excl, excl, T(0));
+    std::copy(in, in + n, mx);
+    prefix::inclusive(n, mx, mx, prefix::Max{});
+  };
+  return check<T>("simd", simd) && check<T>("threads", threads)
+         && check<T>("in place", inPlace);
+}
+
+BENCHMARK(intScan<Std>);
+#ifdef HAVE_PAR
+BENCHMARK(intScan<StdPar>);
+#endif
+BENCHMARK(intScan<Simd>);
+BENCHMARK(intScan<Threads>);
+BENCHMARK(floatScan<Std>);
+#ifdef HAVE_PAR
+BENCHMARK(floatScan<StdPar>);
+#endif
+BENCHMARK(floatScan<Simd>);
+BENCHMARK(floatScan<Threads>);
+
+int main(int argc, char** argv)
+{
+  if (!checkAll<int>() || !checkAll<float>() || !checkAll<double>())
+    return 1;
+  return benchmark::main(argc, argv);
+}
@@ -0,0 +1,156 @@
+#ifndef PREFIX_SCAN_H
+#define PREFIX_SCAN_H
+//
+//  inclusive and exclusive scans (prefix sums, maxima...) of arrays of 4 or
+//  8 byte numbers, for any associative operator: the offsets of a CSR
+//  matrix, the output positions of a stream compaction, the CDF of a
+//  histogram
+//
+//    prefix::inclusive(n, in, out);         // out[i] = in[0] + ... + in[i]
+//    prefix::exclusive(n, in, out, 0);      // out[i] = in[0] + ... + in[i-1]
+//    prefix::inclusive(n, in, out, prefix::Max{});
+//    prefix::inclusive(pool, n, in, out);   // on all the threads
+//
+//  an operator is a struct with a templated operator() that works on
+//  numbers and on native vectors of them (x + y, x > y ? x : y...) and its
+//  identity (Plus, Max, Min of reduction.h). in and out may be the same array
+//
+//   - in a native vector of W elements the scan takes log2(W) steps of
+//     shift and op: the dependency from one vector to the next is one op
+//   - on the threads, the array is cut in rounds of one block per thread,
+//     small enough to stay in the L2 between the two passes: each thread
+//     first reduces its block, then (after a barrier) scans it starting from
+//     the total of the blocks before it
+//
+//  with floating point the sums are associated differently than in the
+//  loop (and differently with one or more threads): the results differ by
+//  rounding
+//
+
+#include "gemm.h"
+#include "reduction.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace prefix {
+
+using reduction::Max;
+using reduction::Min;
+using reduction::Plus;
+
+// elements per thread and per round of the threaded scans (floats: 256 KB)
+constexpr std::size_t BlockSize = 1 << 16;
+
+// v shifted up by S lanes, the lanes below S taken from fill
+template<int S, typename V>
+inline V shiftUp(V v, V fill)
+{
+  constexpr int W = sizeof(V) / sizeof(v[0]);
+  using I = std::conditional_t<sizeof(v[0]) == 4, std::int32_t, std::int64_t>;
+  typedef I M __attribute__((vector_size(sizeof(V))));
+  M mask;
+  for (int l = 0; l < W; ++l)
+    mask[l] = l >= S ? l - S : W;
+  return __builtin_shuffle(v, fill, mask);
+}
+
+// in register: lane l becomes op(v[0], ..., v[l])
+template<int S = 1, typename V, typename Op, typename T>
+inline V scanVector(V v, Op op, T id)
+{
+  constexpr int W = sizeof(V) / sizeof(T);
+  if constexpr (S < W)
+    return scanVector<2 * S>(op(shiftUp<S>(v, V{} + id), v), op, id);
+  else
+    return v;
+}
+
+// out[i] = op(carry, in[0], ..., in[i]) (EXCLUSIVE: up to in[i-1]),
+// returns op(carry, in[0], ..., in[n-1])
+template<bool EXCLUSIVE, typename T, typename Op, int VB = gemm::nativeBytes>
+T scanBlock(std::size_t n, T const* in, T* out, T carry, Op op)
+{
+  using NT        = gemm::Native<T, VB>;
+  using V         = typename NT::V;
+  constexpr int W = NT::size;
+  T const id      = Op::template identity<T>();
+  std::size_t i   = 0;
+  for (; i + W <= n; i += W) {
+    V v = op(V{} + carry, scanVector(NT::load(in + i), op, id));
+    NT::store(out + i, EXCLUSIVE ? shiftUp<1>(v, V{} + carry) : v);
+    carry = v[W - 1];
+  }
+  for (; i < n; ++i) {
+    T x    = op(carry, in[i]);
+    out[i] = EXCLUSIVE ? carry : x;
+    carry  = x;
+  }
+  return carry;
+}
+
+template<typename T, typename Op = Plus, int VB = gemm::nativeBytes>
+void inclusive(std::size_t n, T const* in, T* out, Op op = {},
+               T init = Op::template identity<T>())
+{
+  scanBlock<false, T, Op, VB>(n, in, out, init, op);
+}
+
+// as std::exclusive_scan: out[0] = init
+template<typename T, typename Op = Plus, int VB = gemm::nativeBytes>
+void exclusive(std::size_t n, T const* in, T* out, T init, Op op = {})
+{
+  scanBlock<true, T, Op, VB>(n, in, out, init, op);
+}
+
+// on the threads of the pool (two passes over blocks in the cache)
+template<bool EXCLUSIVE, typename T, typename Op, int VB = gemm::nativeBytes>
+void scan(benchmark::ThreadPool& pool, std::size_t n, T const* in, T* out,
+          T init, Op op)
+{
+  struct alignas(64) Partial
+  {
+    T value;
+  };
+  std::vector<Partial> partial(pool.size());
+  pool.run([&](int tid, int nThreads) {
+    // every thread follows the carry from one round to the next
+    T carry = init;
+    for (std::size_t r = 0; r < n; r += nThreads * BlockSize) {
+      auto bound = [&](int t) {
+        return std::min(n, r + t * BlockSize);
+      };
+      std::size_t lo = bound(tid), hi = bound(tid + 1);
+      partial[tid].value = reduction::reduce<8, VB>(hi - lo, in + lo, op);
+      pool.barrier();
+      T x = carry;
+      for (int t = 0; t < tid; ++t)
+        x = op(x, partial[t].value);
+      scanBlock<EXCLUSIVE, T, Op, VB>(hi - lo, in + lo, out + lo, x, op);
+      for (int t = 0; t < nThreads; ++t)
+        carry = op(carry, partial[t].value);
+      pool.barrier();
+    }
+  });
+}
+
+template<typename T, typename Op = Plus, int VB = gemm::nativeBytes>
+void inclusive(benchmark::ThreadPool& pool, std::size_t n, T const* in,
+               T* out, Op op = {}, T init = Op::template identity<T>())
+{
+  scan<false, T, Op, VB>(pool, n, in, out, init, op);
+}
+
+template<typename T, typename Op = Plus, int VB = gemm::nativeBytes>
+void exclusive(benchmark::ThreadPool& pool, std::size_t n, T const* in,
+               T* out, T init, Op op = {})
+{
+  scan<true, T, Op, VB>(pool, n, in, out, init, op);
+}
+
+} // namespace prefix
+
+#endif
@@ -0,0 +1,159 @@
+//
+//  sum += x[i]: the plain loop (latency bound, not vectorized without
+//  -ffast-math) against reduction.h with 1, 2, 4 and 8 accumulators, and
+//  dot product, min/max and sum of squares
+//
+//  c++ -O2 -march=native reduction.cpp
+//  ./a.out --filter=sum
+//
+//  then the plain loop with -O2 -ffast-math: same speed? Same result?
+//  The sums of reduction.h do not change with the compiler options
+//  (except the vector size), dot and moments do with -march (fma)
+//
+#include "benchRunner.h"
+#include "reduction.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// 16 KB: in the L1, the reduction is not limited by the memory
+constexpr std::size_t N = 4096 - 3;
+
+std::vector<float>& data()
+{
+  static std::vector<float> x = [] {
+    std::mt19937 eng;
+    std::normal_distribution<float> gauss(10., 1.);
+    std::vector<float> v(N);
+    for (auto& y : v)
+      y = gauss(eng);
+    return v;
+  }();
+  return x;
+}
+
+void result(char const* what, double r)
+{
+  static double ref = 0;
+  if (ref == 0)
+    for (auto y : data())
+      ref += y;
+  std::cout << what << ' ' << std::setprecision(9) << r << ", relative to the "
+            << "sum in double " << (r - ref) / ref << std::endl;
+}
+
+void sumLoop(benchmark::State& st)
+{
+  auto& x = data();
+  float s = 0;
+  st.setItems(N);
+  st.setFlops(N);
+  while (st.next()) {
+    benchmark::touch(x);
+    s = 0;
+    for (std::size_t i = 0; i < N; ++i)
+      s += x[i];
+    benchmark::keep(s);
+  }
+  result("loop", s);
+}
+
+template<int NACC>
+void sumAcc(benchmark::State& st)
+{
+  auto& x = data();
+  float s = 0;
+  st.setItems(N);
+  st.setFlops(N);
+  while (st.next()) {
+    benchmark::touch(x);
+    s = reduction::sum<NACC>(N, x.data());
+    benchmark::keep(s);
+  }
+  result("reduction::sum", s);
+}
+
+template<bool LOOP>
+void dotKernel(benchmark::State& st)
+{
+  auto& x = data();
+  std::vector<float> y(x.rbegin(), x.rend());
+  float s = 0;
+  st.setItems(N);
+  st.setFlops(2. * N);
+  while (st.next()) {
+    benchmark::touch(x);
+    if (LOOP) {
+      s = 0;
+      for (std::size_t i = 0; i < N; ++i)
+        s += x[i] * y[i];
+    } else
+      s = reduction::dot(N, x.data(), y.data());
+    benchmark::keep(s);
+  }
+}
+
+template<bool LOOP>
+void minMaxKernel(benchmark::State& st)
+{
+  auto& x = data();
+  float mn = 0, mx = 0;
+  st.setItems(N);
+  while (st.next()) {
+    benchmark::touch(x);
+    if (LOOP) {
+      mn = mx = x[0];
+      for (std::size_t i = 1; i < N; ++i) {
+        mn = std::min(mn, x[i]);
+        mx = std::max(mx, x[i]);
+      }
+    } else {
+      mn = reduction::min(N, x.data());
+      mx = reduction::max(N, x.data());
+    }
+    benchmark::keep(mn);
+    benchmark::keep(mx);
+  }
+  std::cout << "min " << mn << " max " << mx << std::endl;
+}
+
+// m and m2 of randg.cpp
+template<bool LOOP>
+void momentsKernel(benchmark::State& st)
+{
+  auto& x = data();
+  reduction::Moments<float> m{};
+  st.setItems(N);
+  st.setFlops(3. * N);
+  while (st.next()) {
+    benchmark::touch(x);
+    if (LOOP) {
+      m = {0, 0};
+      for (std::size_t i = 0; i < N; ++i) {
+        m.sum += x[i];
+        m.sum2 += x[i] * x[i];
+      }
+    } else
+      m = reduction::moments(N, x.data());
+    benchmark::keep(m);
+  }
+  std::cout << "ave " << m.sum / N << " rms "
+            << std::sqrt((m.sum2 - m.sum * m.sum / N) / (N - 1)) << std::endl;
+}
+
+BENCHMARK(sumLoop);
+BENCHMARK(sumAcc<1>);
+BENCHMARK(sumAcc<2>);
+BENCHMARK(sumAcc<4>);
+BENCHMARK(sumAcc<8>);
+BENCHMARK(dotKernel<true>);
+BENCHMARK(dotKernel<false>);
+BENCHMARK(minMaxKernel<true>);
+BENCHMARK(minMaxKernel<false>);
+BENCHMARK(momentsKernel<true>);
+BENCHMARK(momentsKernel<false>);
+
+BENCHMARK_MAIN()
@@ -0,0 +1,205 @@
+#ifndef REDUCTION_H
+#define REDUCTION_H
+//
+//  reductions (sum, dot product, min, max, sum and sum of squares) with NACC
+//  independent vector accumulators:
+//
+//    float s = reduction::sum(n, x);          // NACC = 8
+//    float d = reduction::dot<4>(n, x, y);
+//    auto m  = reduction::moments(n, x);      // m.sum, m.sum2 (see randg.cpp)
+//
+//  the plain loop (sum += x[i]) waits for each add before the next: one
+//  element every 4 cycles or so. The compiler may not reorder it (that
+//  changes the result) unless -ffast-math (-fassociative-math) is given.
+//  Here the reordering is written explicitly: element i goes to lane
+//  i % W of accumulator (i / W) % NACC, and NACC W-wide chains run in
+//  parallel. NACC of 8 covers the latency of the add at 2 per cycle
+//
+//  the order of the combination is fixed, so the result of sum, min and
+//  max depends only on n, NACC and W (the vector size, VB bytes), not on
+//  alignment or timing:
+//   - the full vectors left after the last group of NACC go to
+//     accumulators 0, 1, ... and the last elements (less than a vector) to
+//     a scalar, in order
+//   - the accumulators are combined as a tree: (0 1) (2 3)..., then
+//     (01 23)..., the lanes likewise: l with l + W/2, then l + W/4...
+//   - the scalar tail comes last
+//  pass the same VB on all hosts for bitwise identical results (wider
+//  vectors than the hardware are split by the compiler). dot and moments
+//  multiply and add: the compiler may contract the two into an fma (the
+//  default when the target has one, e.g. -march=native), which rounds once
+//  instead of twice, so their results depend on -march as well; build with
+//  -ffp-contract=off for the same bits everywhere
+//
+//  an operator is a struct with a templated operator() that works on
+//  numbers and on native vectors of them and its identity (Plus, Max, Min)
+//
+
+#include "gemm.h"
+#include <cstddef>
+#include <limits>
+
+namespace reduction {
+
+struct Plus
+{
+  template<typename V>
+  V operator()(V x, V y) const
+  {
+    return x + y;
+  }
+  template<typename T>
+  static constexpr T identity()
+  {
+    return T(0);
+  }
+};
+
+struct Max
+{
+  template<typename V>
+  V operator()(V x, V y) const
+  {
+    return x > y ? x : y;
+  }
+  template<typename T>
+  static constexpr T identity()
+  {
+    return std::numeric_limits<T>::lowest();
+  }
+};
+
+struct Min
+{
+  template<typename V>
+  V operator()(V x, V y) const
+  {
+    return x < y ? x : y;
+  }
+  template<typename T>
+  static constexpr T identity()
+  {
+    return std::numeric_limits<T>::max();
+  }
+};
+
+// the accumulators, then the lanes, as a tree (see above)
+template<typename T, int NACC, typename V, typename Op>
+T combine(V (&acc)[NACC], Op op)
+{
+  constexpr int W = sizeof(V) / sizeof(T);
+  for (int s = 1; s < NACC; s *= 2)
+    for (int u = 0; u + s < NACC; u += 2 * s)
+      acc[u] = op(acc[u], acc[u + s]);
+  T l[W];
+  for (int i = 0; i < W; ++i)
+    l[i] = acc[0][i];
+  for (int w = W / 2; w > 0; w /= 2)
+    for (int i = 0; i < w; ++i)
+      l[i] = op(l[i], l[i + w]);
+  return l[0];
+}
+
+// op over i < n of the terms vec(i) (W of them, from i) and scalar(i),
+// each accumulator updated as acc = op(acc, term)
+template<int NACC, typename T, int VB, typename Op, typename FV, typename FS>
+T reduce(std::size_t n, Op op, FV vec, FS scalar)
+{
+  using NT        = gemm::Native<T, VB>;
+  using V         = typename NT::V;
+  constexpr int W = NT::size;
+  V acc[NACC];
+  for (auto& v : acc)
+    v = V{} + Op::template identity<T>();
+  std::size_t i = 0;
+  for (; i + NACC * W <= n; i += NACC * W)
+#pragma GCC unroll 16
+    for (int u = 0; u < NACC; ++u)
+      acc[u] = op(acc[u], vec(i + u * W));
+  for (int u = 0; i + W <= n; i += W, ++u)
+    acc[u] = op(acc[u], vec(i));
+  T tail = Op::template identity<T>();
+  for (; i < n; ++i)
+    tail = op(tail, scalar(i));
+  return op(combine<T>(acc, op), tail);
+}
+
+// op of the n elements of x
+template<int NACC = 8, int VB = gemm::nativeBytes, typename T, typename Op>
+T reduce(std::size_t n, T const* x, Op op)
+{
+  using NT = gemm::Native<T, VB>;
+  return reduce<NACC, T, VB>(
+      n, op, [=](std::size_t i) { return NT::load(x + i); },
+      [=](std::size_t i) { return x[i]; });
+}
+
+template<int NACC = 8, int VB = gemm::nativeBytes, typename T>
+T sum(std::size_t n, T const* x)
+{
+  return reduce<NACC, VB>(n, x, Plus{});
+}
+
+template<int NACC = 8, int VB = gemm::nativeBytes, typename T>
+T min(std::size_t n, T const* x)
+{
+  return reduce<NACC, VB>(n, x, Min{});
+}
+
+template<int NACC = 8, int VB = gemm::nativeBytes, typename T>
+T max(std::size_t n, T const* x)
+{
+  return reduce<NACC, VB>(n, x, Max{});
+}
+
+// sum of x[i] y[i] (a multiply and an add per element and accumulator, an
+// fma if contracted, see above)
+template<int NACC = 8, int VB = gemm::nativeBytes, typename T>
+T dot(std::size_t n, T const* x, T const* y)
+{
+  using NT = gemm::Native<T, VB>;
+  return reduce<NACC, T, VB>(
+      n, Plus{},
+      [=](std::size_t i) { return NT::load(x + i) * NT::load(y + i); },
+      [=](std::size_t i) { return x[i] * y[i]; });
+}
+
+template<typename T>
+struct Moments
+{
+  T sum, sum2;
+};
+
+// sum and sum of squares in one pass, in the same order as sum() (sum2
+// depends on the contraction into fma, see above)
+template<int NACC = 8, int VB = gemm::nativeBytes, typename T>
+Moments<T> moments(std::size_t n, T const* x)
+{
+  using NT        = gemm::Native<T, VB>;
+  using V         = typename NT::V;
+  constexpr int W = NT::size;
+  V acc[NACC], acc2[NACC];
+  for (int u = 0; u < NACC; ++u)
+    acc[u] = acc2[u] = V{} + T(0);
+  auto add = [&](int u, V v) {
+    acc[u] += v;
+    acc2[u] += v * v;
+  };
+  std::size_t i = 0;
+  for (; i + NACC * W <= n; i += NACC * W)
+#pragma GCC unroll 16
+    for (int u = 0; u < NACC; ++u)
+      add(u, NT::load(x + i + u * W));
+  for (int u = 0; i + W <= n; i += W, ++u)
+    add(u, NT::load(x + i));
+  T tail = 0, tail2 = 0;
+  for (; i < n; ++i) {
+    tail += x[i];
+    tail2 += x[i] * x[i];
+  }
+  return {combine<T>(acc, Plus{}) + tail, combine<T>(acc2, Plus{}) + tail2};
+}
+
+} // namespace reduction
+
+#endif
@@ -0,0 +1,18 @@
+//
+// measures peak FLOP/s and bandwidth of each memory level of this host
+//
+// compile with
+//  c++ -O2 -Wall roofline.cpp
+//
+// kernels registered with benchRunner.h are placed on this roofline
+// when run with --roofline (they must declare flops and bytes per sample)
+//
+
+#include "roofline.h"
+#include <iostream>
+
+int main()
+{
+  roofline::print(std::cout, roofline::machine());
+  return 0;
+}
@@ -0,0 +1,387 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+//
+//  measures the roofs of the host and places kernels below them
+//
+//  peak FLOP/s: long chains of independent scalar, SSE, AVX and FMA
+//  (and AVX-512 FMA if supported) operations, one function per ISA selected
+//  at run time, so no need to compile with -march=native
+//  bandwidth: a read-only reduction (AVX if available) over a working set of
+//  half of each cache level and of several times the LLC for DRAM
+//
+//  a kernel of given flops and bytes per call is then "compute bound" if its
+//  arithmetic intensity (flop/byte) is above the ridge point (peak/bandwidth)
+//  of the memory level its working set fits in, and "bandwidth bound" if not
+//
+//  off x86 the peaks are those of plain float and of 16 byte GCC vectors
+//  (what the compiler makes of them) and the bandwidth is read with the
+//  latter: a rougher estimate
+//
+
+#include "benchmark.h"
+#include "cacheState.h"
+#include "cycleTimer.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace roofline {
+
+struct Peak
+{
+  std::string name;
+  double gflops;
+};
+
+struct Level
+{
+  std::string name;
+  double size;       // bytes of the cache (0 for DRAM)
+  double workingSet; // bytes used for the probe
+  double gbs;
+};
+
+struct Machine
+{
+  std::vector<Peak> peaks;
+  std::vector<Level> levels;
+
+  double peak() const
+  {
+    double p = 0;
+    for (auto const& x : peaks)
+      p = std::max(p, x.gflops);
+    return p;
+  }
+
+  // smallest level holding the working set
+  Level const& levelFor(double workingSet) const
+  {
+    for (auto const& l : levels)
+      if (l.size > 0 && workingSet <= l.size)
+        return l;
+    return levels.back();
+  }
+};
+
+namespace probe {
+
+constexpr long long NIter = 1 << 22;
+
+// best of a few runs in ns
+template<typename F>
+double best(F f)
+{
+  double t = 1.e30;
+  for (int k = 0; k < 5; ++k) {
+    benchmark::CycleTimer ct;
+    ct.start();
+    f();
+    ct.stop();
+    t = std::min(t, ct.ns());
+  }
+  return t;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 8 mul chains and 8 add chains: 2 flops per mul/add pair per lane
+inline float scalarMulAdd()
+{
+  __m128 m[8], a[8];
+  for (int i = 0; i < 8; ++i) {
+    m[i] = _mm_set_ss(1.f + i);
+    a[i] = _mm_set_ss(float(i));
+  }
+  auto const f = _mm_set_ss(0.9999999f);
+  auto const d = _mm_set_ss(1.e-7f);
+  for (long long n = 0; n < NIter; ++n) {
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+      m[i] = _mm_mul_ss(m[i], f);
+      a[i] = _mm_add_ss(a[i], d);
+    }
+  }
+  float r = 0;
+  for (int i = 0; i < 8; ++i)
+    r += _mm_cvtss_f32(m[i]) + _mm_cvtss_f32(a[i]);
+  return r;
+}
+
+inline float sseMulAdd()
+{
+  __m128 m[8], a[8];
+  for (int i = 0; i < 8; ++i) {
+    m[i] = _mm_set1_ps(1.f + i);
+    a[i] = _mm_set1_ps(float(i));
+  }
+  auto const f = _mm_set1_ps(0.9999999f);
+  auto const d = _mm_set1_ps(1.e-7f);
+  for (long long n = 0; n < NIter; ++n) {
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+      m[i] = _mm_mul_ps(m[i], f);
+      a[i] = _mm_add_ps(a[i], d);
+    }
+  }
+  float r = 0;
+  for (int i = 0; i < 8; ++i)
+    r += _mm_cvtss_f32(m[i]) + _mm_cvtss_f32(a[i]);
+  return r;
+}
+
+__attribute__((target("avx2"))) inline float avxMulAdd()
+{
+  __m256 m[8], a[8];
+  for (int i = 0; i < 8; ++i) {
+    m[i] = _mm256_set1_ps(1.f + i);
+    a[i] = _mm256_set1_ps(float(i));
+  }
+  auto const f = _mm256_set1_ps(0.9999999f);
+  auto const d = _mm256_set1_ps(1.e-7f);
+  for (long long n = 0; n < NIter; ++n) {
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+      m[i] = _mm256_mul_ps(m[i], f);
+      a[i] = _mm256_add_ps(a[i], d);
+    }
+  }
+  float r = 0;
+  for (int i = 0; i < 8; ++i)
+    r += _mm256_cvtss_f32(m[i]) + _mm256_cvtss_f32(a[i]);
+  return r;
+}
+
+// 12 fma chains: 2 flops per fma per lane
+__attribute__((target("avx2,fma"))) inline float avxFMA()
+{
+  __m256 a[12];
+  for (int i = 0; i < 12; ++i)
+    a[i] = _mm256_set1_ps(float(i));
+  auto const f = _mm256_set1_ps(0.9999999f);
+  auto const d = _mm256_set1_ps(1.e-7f);
+  for (long long n = 0; n < NIter; ++n) {
+#pragma GCC unroll 12
+    for (int i = 0; i < 12; ++i)
+      a[i] = _mm256_fmadd_ps(a[i], f, d);
+  }
+  float r = 0;
+  for (int i = 0; i < 12; ++i)
+    r += _mm256_cvtss_f32(a[i]);
+  return r;
+}
+
+__attribute__((target("avx512f"))) inline float avx512FMA()
+{
+  __m512 a[12];
+  for (int i = 0; i < 12; ++i)
+    a[i] = _mm512_set1_ps(float(i));
+  auto const f = _mm512_set1_ps(0.9999999f);
+  auto const d = _mm512_set1_ps(1.e-7f);
+  for (long long n = 0; n < NIter; ++n) {
+#pragma GCC unroll 12
+    for (int i = 0; i < 12; ++i)
+      a[i] = _mm512_fmadd_ps(a[i], f, d);
+  }
+  float r = 0;
+  for (int i = 0; i < 12; ++i)
+    r += _mm512_cvtss_f32(a[i]);
+  return r;
+}
+
+// read only, 8 independent accumulators
+inline float sseRead(float const* p, long long n)
+{
+  __m128 a[8];
+  for (auto& x : a)
+    x = _mm_setzero_ps();
+  for (long long i = 0; i < n; i += 32) {
+#pragma GCC unroll 8
+    for (int k = 0; k < 8; ++k)
+      a[k] = _mm_add_ps(a[k], _mm_load_ps(p + i + 4 * k));
+  }
+  for (int k = 1; k < 8; ++k)
+    a[0] = _mm_add_ps(a[0], a[k]);
+  return _mm_cvtss_f32(a[0]);
+}
+
+__attribute__((target("avx2"))) inline float avxRead(float const* p,
+                                                     long long n)
+{
+  __m256 a[8];
+  for (auto& x : a)
+    x = _mm256_setzero_ps();
+  for (long long i = 0; i < n; i += 64) {
+#pragma GCC unroll 8
+    for (int k = 0; k < 8; ++k)
+      a[k] = _mm256_add_ps(a[k], _mm256_load_ps(p + i + 8 * k));
+  }
+  for (int k = 1; k < 8; ++k)
+    a[0] = _mm256_add_ps(a[0], a[k]);
+  return _mm256_cvtss_f32(a[0]);
+}
+#else
+using float4 = float __attribute__((vector_size(16)));
+
+inline float lane0(float x)
+{
+  return x;
+}
+inline float lane0(float4 x)
+{
+  return x[0];
+}
+
+// as scalarMulAdd and sseMulAdd, V float or float4
+template<typename V>
+inline float mulAdd()
+{
+  V m[8], a[8];
+  for (int i = 0; i < 8; ++i) {
+    m[i] = V{} + (1.f + i);
+    a[i] = V{} + float(i);
+  }
+  V const f = V{} + 0.9999999f;
+  V const d = V{} + 1.e-7f;
+  for (long long n = 0; n < NIter; ++n) {
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+      m[i] = m[i] * f;
+      a[i] = a[i] + d;
+    }
+  }
+  float r = 0;
+  for (int i = 0; i < 8; ++i)
+    r += lane0(m[i]) + lane0(a[i]);
+  return r;
+}
+
+inline float vecRead(float const* p, long long n)
+{
+  float4 a[8] = {};
+  for (long long i = 0; i < n; i += 32) {
+#pragma GCC unroll 8
+    for (int k = 0; k < 8; ++k) {
+      float4 x;
+      __builtin_memcpy(&x, p + i + 4 * k, sizeof(x));
+      a[k] += x;
+    }
+  }
+  for (int k = 1; k < 8; ++k)
+    a[0] += a[k];
+  return a[0][0];
+}
+#endif
+
+} // namespace probe
+
+inline Machine measure()
+{
+  using namespace probe;
+  Machine m;
+  float sink = 0;
+  auto peak  = [&](std::string name, double flopsPerIter, float (*f)()) {
+    double ns = best([&] { sink += f(); });
+    m.peaks.push_back({std::move(name), flopsPerIter * NIter / ns});
+  };
+#if defined(__x86_64__) || defined(__i386__)
+  peak("scalar mul+add", 16, scalarMulAdd);
+  peak("SSE mul+add", 64, sseMulAdd);
+  if (__builtin_cpu_supports("avx2"))
+    peak("AVX mul+add", 128, avxMulAdd);
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    peak("AVX FMA", 12 * 16, avxFMA);
+  if (__builtin_cpu_supports("avx512f"))
+    peak("AVX-512 FMA", 12 * 32, avx512FMA);
+
+  auto read = __builtin_cpu_supports("avx2") ? avxRead : sseRead;
+#else
+  peak("scalar mul+add", 16, mulAdd<float>);
+  peak("16B vector mul+add", 64, mulAdd<float4>);
+
+  auto read = vecRead;
+#endif
+  auto bw   = [&](std::string name, double size, double ws) {
+    long long n = ws / sizeof(float);
+    n           = std::max(64LL, n - n % 64);
+    auto p      = (float*)aligned_alloc(64, n * sizeof(float));
+    for (long long i = 0; i < n; ++i)
+      p[i] = 1.e-6f * (i & 1023);
+    // read at least 1GB per measurement
+    int reps  = std::max(1LL, (1LL << 30) / (n * 4));
+    double ns = best([&] {
+      for (int r = 0; r < reps; ++r) {
+        sink += read(p, n);
+        benchmark::keep(p);
+      }
+    });
+    m.levels.push_back({std::move(name), size, double(n * 4),
+                        double(reps) * n * 4 / ns});
+    free(p);
+  };
+  double llc = 0;
+  for (auto const& c : benchmark::cacheSizes()) {
+    bw("L" + std::to_string(c.first), c.second, c.second / 2);
+    llc = c.second;
+  }
+  bw("DRAM", 0, std::min(std::max(4 * llc, 256.e6), 1.e9));
+  benchmark::keep(sink);
+  return m;
+}
+
+// measured once per process
+inline Machine const& machine()
+{
+  static const Machine m = measure();
+  return m;
+}
+
+inline void print(std::ostream& co, Machine const& m)
+{
+  char buf[256];
+  for (auto const& p : m.peaks) {
+    snprintf(buf, sizeof(buf), "%-16s %10.2f GFLOP/s\n", p.name.c_str(),
+             p.gflops);
+    co << buf;
+  }
+  for (auto const& l : m.levels) {
+    snprintf(buf, sizeof(buf),
+             "%-16s %10.2f GB/s  (working set %.3g MB)  ridge %.2f flop/byte\n",
+             l.name.c_str(), l.gbs, l.workingSet / 1.e6, m.peak() / l.gbs);
+    co << buf;
+  }
+}
+
+struct Placement
+{
+  double gflops;     // achieved
+  double intensity;  // flop/byte
+  double roof;       // attainable GFLOP/s at this intensity
+  std::string level; // where the working set fits
+  bool computeBound;
+};
+
+// flops and bytes moved per call, working set in bytes, time per call in ns
+inline Placement place(Machine const& m, double flops, double bytes,
+                       double workingSet, double ns)
+{
+  Placement p;
+  auto const& l  = m.levelFor(workingSet);
+  p.gflops       = flops / ns;
+  p.intensity    = bytes > 0 ? flops / bytes
+                              : std::numeric_limits<double>::infinity();
+  p.roof         = std::min(m.peak(), p.intensity * l.gbs);
+  p.level        = l.name;
+  p.computeBound = p.intensity * l.gbs >= m.peak();
+  return p;
+}
+
+} // namespace roofline
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+//
+//  a fixed set of (optionally pinned) threads running the same function,
+//  SPMD style:
+//
+//    benchmark::ThreadPool pool(8);
+//    pool.run([&](int tid, int nThreads) {
+//      ... phase 1 on my share ...
+//      pool.barrier();
+//      ... phase 2 ...
+//    });
+//
+//  the calling thread is thread 0 and run() returns when all are done.
+//  Workers wait on a condition variable between runs (no busy loop), the
+//  barrier inside a run spins, as the threads are supposed to be busy
+//
+
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace benchmark {
+
+// pin the calling thread
+inline bool pin(int cpu)
+{
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET(cpu, &mask);
+  return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+}
+
+// sense reversing, threads are pinned and not oversubscribed (usually)
+class SpinBarrier
+{
+public:
+  explicit SpinBarrier(int n)
+      : n_(n)
+  {}
+
+  void wait()
+  {
+    bool sense = !sense_.load(std::memory_order_relaxed);
+    if (count_.fetch_add(1, std::memory_order_acq_rel) == n_ - 1) {
+      count_.store(0, std::memory_order_relaxed);
+      sense_.store(sense, std::memory_order_release);
+    } else {
+      while (sense_.load(std::memory_order_acquire) != sense)
+        std::this_thread::yield();
+    }
+  }
+
+private:
+  int const n_;
+  std::atomic<int> count_{0};
+  std::atomic<bool> sense_{false};
+};
+
+class ThreadPool
+{
+public:
+  using Job = std::function<void(int tid, int nThreads)>;
+
+  // thread i is pinned to cpus[i % cpus.size()] if cpus are given
+  // (the calling thread, thread 0, included)
+  explicit ThreadPool(int n, std::vector<int> const& cpus = {})
+      : n_(std::max(1, n))
+      , barrier_(n_)
+  {
+    for (int tid = 1; tid < n_; ++tid)
+      workers_.emplace_back([=] {
+        if (!cpus.empty())
+          pin(cpus[tid % cpus.size()]);
+        loop(tid);
+      });
+    if (!cpus.empty())
+      pin(cpus[0]);
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      stop_ = true;
+      ++generation_;
+    }
+    cv_.notify_all();
+    for (auto& w : workers_)
+      w.join();
+  }
+
+  ThreadPool(ThreadPool const&) = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+
+  int size() const
+  {
+    return n_;
+  }
+
+  void run(Job const& job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      job_     = &job;
+      pending_ = n_ - 1;
+      ++generation_;
+    }
+    cv_.notify_all();
+    job(0, n_);
+    while (pending_.load(std::memory_order_acquire) > 0)
+      std::this_thread::yield();
+  }
+
+  // all the threads of a run
+  void barrier()
+  {
+    barrier_.wait();
+  }
+
+private:
+  void loop(int tid)
+  {
+    long seen = 0;
+    for (;;) {
+      Job const* job;
+      {
+        std::unique_lock<std::mutex> lock(m_);
+        cv_.wait(lock, [&] { return generation_ != seen; });
+        seen = generation_;
+        if (stop_)
+          return;
+        job = job_;
+      }
+      (*job)(tid, n_);
+      pending_.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  int const n_;
+  SpinBarrier barrier_;
+  std::vector<std::thread> workers_;
+  std::mutex m_;
+  std::condition_variable cv_;
+  Job const* job_  = nullptr;
+  long generation_ = 0;
+  bool stop_       = false;
+  std::atomic<int> pending_{0};
+};
+
+} // namespace benchmark
+
+#endif
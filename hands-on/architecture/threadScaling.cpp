@@ -0,0 +1,194 @@
+//
+//  thread scaling of the pi, matmul (naive and blocked) and histogram kernels
+//
+//  c++ -O2 -march=native -pthread threadScaling.cpp
+//  ./a.out --kernel=histo --pin=scatter --threads=all
+//  (--kernel=pi|matmul|gemm|histo, all by default, see threadScaling.h for the
+//  other options)
+//
+//  pi is compute bound and should scale with the number of physical cores
+//  (SMT siblings do not help much), the histogram streams its input from
+//  memory and saturates the bandwidth of a socket with a few threads.
+//  Compare compact and scatter on a dual socket node
+//
+
+#include "../vectorization/simpleSinCos.h"
+#include "benchmark.h"
+#include "gemm.h"
+#include "threadScaling.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// one per thread, on its own cache lines
+template<typename T>
+struct alignas(64) Padded
+{
+  T value;
+};
+
+int maxThreads(benchmark::ScalingOptions const& opt)
+{
+  return std::max<int>(opt.maxThreads, benchmark::topology().size());
+}
+
+void pi(benchmark::ScalingOptions const& opt)
+{
+  constexpr long long N = 1LL << 28;
+  double const step     = 1. / N;
+  std::vector<Padded<double>> sum(maxThreads(opt));
+
+  auto work = [&](int tid, int nThreads) {
+    auto r   = benchmark::share(N, tid, nThreads);
+    double s = 0;
+    for (auto i = r.first; i < r.second; ++i) {
+      double x = (i + 0.5) * step;
+      s += 4. / (1. + x * x);
+    }
+    sum[tid].value = s;
+  };
+  // 6 flops per step
+  auto res = benchmark::scaling(std::cout, "pi", work, 0, 6. * N, opt);
+  double s = 0;
+  for (int i = 0; i < res.back().threads; ++i)
+    s += sum[i].value;
+  std::cout << "pi = " << step * s << '\n' << std::endl;
+}
+
+void matmul(benchmark::ScalingOptions const& opt)
+{
+  constexpr int N = 1000;
+  std::unique_ptr<float[]> a(new float[N * N]), b(new float[N * N]),
+      c(new float[N * N]);
+
+  // each thread works (and first-touches) on a band of rows
+  auto setup = [&](int tid, int nThreads) {
+    auto r = benchmark::share(N, tid, nThreads);
+    for (auto m : {a.get(), b.get(), c.get()})
+      benchmark::releasePages(m + r.first * N, m + r.second * N);
+    for (auto i = r.first * N; i < r.second * N; ++i) {
+      a[i] = 1.3458f;
+      b[i] = 2.467f;
+      c[i] = 0;
+    }
+  };
+  auto work = [&](int tid, int nThreads) {
+    auto r = benchmark::share(N, tid, nThreads);
+    for (auto i = r.first; i < r.second; ++i)
+      for (int k = 0; k < N; ++k)
+        for (int j = 0; j < N; ++j)
+          c[i * N + j] += a[i * N + k] * b[k * N + j];
+    if (r.first < r.second)
+      benchmark::keep(c[r.first * N]);
+  };
+  benchmark::scaling(std::cout, "matmul", work, 4. * N * N * sizeof(float),
+                     2. * N * N * N, opt, setup);
+  std::cout << std::endl;
+}
+
+// the blocked gemm of gemm.h, on the threads of the harness
+void blockedGemm(benchmark::ScalingOptions const& opt)
+{
+  constexpr int N = 2000;
+  std::vector<float> a(N * N, 1.3458f), b(N * N, 2.467f), c(N * N, 0);
+  auto bl = gemm::defaultBlocking<float>();
+  gemm::Buffer<float> bufB;
+  auto pb = bufB.get(std::size_t(bl.nc + gemm::NR<float>) * bl.kc);
+  // one barrier per team size
+  std::vector<std::unique_ptr<benchmark::SpinBarrier>> barriers;
+  for (int n = 0; n <= maxThreads(opt); ++n)
+    barriers.emplace_back(new benchmark::SpinBarrier(n));
+
+  auto work = [&](int tid, int nThreads) {
+    gemm::gemmTeam(tid, nThreads, *barriers[nThreads], pb, N, N, N, 1.f,
+                   a.data(), N, b.data(), N, 0.f, c.data(), N, bl);
+  };
+  benchmark::scaling(std::cout, "gemm", work, 3. * N * N * sizeof(float),
+                     2. * N * N * N, opt);
+  std::cout << std::endl;
+}
+
+void histo(benchmark::ScalingOptions const& opt)
+{
+  constexpr long long N = 1LL << 24;
+  constexpr int NBin    = 100;
+  using Hist            = std::array<std::array<int, NBin + 1>, NBin + 1>;
+  std::unique_ptr<float[]> phi(new float[N]), r(new float[N]);
+  // private histograms, merged at the end
+  std::vector<Padded<Hist>> hist(maxThreads(opt));
+
+  auto setup = [&](int tid, int nThreads) {
+    auto s = benchmark::share(N, tid, nThreads);
+    benchmark::releasePages(phi.get() + s.first, phi.get() + s.second);
+    benchmark::releasePages(r.get() + s.first, r.get() + s.second);
+    std::mt19937 eng(tid);
+    std::uniform_real_distribution<float> rgen(0., 1.);
+    for (auto i = s.first; i < s.second; ++i) {
+      phi[i] = -M_PI + 2. * M_PI * rgen(eng);
+      r[i]   = rgen(eng);
+    }
+  };
+  auto work = [&](int tid, int nThreads) {
+    auto s  = benchmark::share(N, tid, nThreads);
+    auto& h = hist[tid].value;
+    memset(&h, 0, sizeof(h));
+    float binWidthI = NBin / 2.;
+    for (auto i = s.first; i < s.second; ++i) {
+      float sn, cs;
+      simpleSinCos(phi[i], sn, cs);
+      int xbin = (r[i] * cs + 1.f) * binWidthI;
+      int ybin = (r[i] * sn + 1.f) * binWidthI;
+      ++h[xbin][ybin];
+    }
+  };
+  // 35 flops with simpleSinCos, phi and r read from memory
+  auto res = benchmark::scaling(std::cout, "histo", work, 8. * N, 35. * N,
+                                opt, setup);
+  long long tot = 0;
+  for (int t = 0; t < res.back().threads; ++t)
+    for (auto const& row : hist[t].value)
+      for (auto n : row)
+        tot += n;
+  std::cout << "entries " << tot << '\n' << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  benchmark::ScalingOptions opt;
+  if (!opt.parse(argc, argv))
+    return 2;
+  std::string kernel = "all";
+  for (int i = 1; i < argc; ++i)
+    if (std::string(argv[i]).compare(0, 9, "--kernel=") == 0)
+      kernel = argv[i] + 9;
+  if (kernel != "all" && kernel != "pi" && kernel != "matmul"
+      && kernel != "gemm" && kernel != "histo") {
+    std::cerr << "error: unknown --kernel=" << kernel
+              << " (all, pi, matmul, gemm or histo)" << std::endl;
+    return 2;
+  }
+
+  auto topo = benchmark::topology();
+  std::cout << topo.size() << " cpus available" << std::endl;
+  for (auto const& c : topo)
+    std::cout << "  cpu " << c.id << ": socket " << c.socket << " core "
+              << c.core << " thread " << c.thread << " node " << c.node
+              << std::endl;
+  std::cout << std::endl;
+
+  if (kernel == "all" || kernel == "pi")
+    pi(opt);
+  if (kernel == "all" || kernel == "matmul")
+    matmul(opt);
+  if (kernel == "all" || kernel == "gemm")
+    blockedGemm(opt);
+  if (kernel == "all" || kernel == "histo")
+    histo(opt);
+  return 0;
+}
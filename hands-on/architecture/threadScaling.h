@@ -0,0 +1,340 @@
+#ifndef THREAD_SCALING_H
+#define THREAD_SCALING_H
+//
+//  runs a kernel on 1..N threads pinned according to the topology of the host
+//  and reports speedup, efficiency and (per thread) bandwidth
+//
+//    auto work = [&](int tid, int nThreads) { ... my share of the work ... };
+//    benchmark::scaling(std::cout, "pi", work, bytes, flops, opt);
+//
+//  the topology (socket, core, SMT thread, NUMA node of each cpu) is read from
+//  sysfs, restricted to the cpus the process is allowed to run on
+//  (taskset/numactl still work). Pinning policies (--pin=...):
+//    compact : the physical cores of a socket, then their SMT siblings,
+//              then the next socket
+//    scatter : alternate sockets, SMT siblings last
+//    cores   : one thread per physical core, no SMT siblings
+//    smt     : both SMT siblings of a core before moving to the next
+//    node    : only the cpus of NUMA node --node=k
+//    none    : no pinning, threads are left to the scheduler
+//  any other name is an error (parse() returns false)
+//  thread counts are the powers of two and the maximum (--threads=all for
+//  each count), --max-threads=n limits them. Asking more threads than cpus
+//  oversubscribes the cpus of the policy in round robin.
+//
+//  time is the median over --reps runs of the slowest thread (all threads
+//  start together after a barrier), after one warmup run.
+//  An optional setup(tid, nThreads) is called by each thread, already
+//  pinned, before the runs: use it to first-touch the data that thread works
+//  on, so that pages are allocated on its NUMA node (releasePages() first,
+//  as setup is called again for each thread count)
+//
+
+#include "threadPool.h"
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace benchmark {
+
+struct Cpu
+{
+  int id;
+  int socket;
+  int core;   // core_id (unique only within a socket)
+  int thread; // index among the SMT siblings of the core
+  int node;   // NUMA node
+};
+
+// "0-3,8,10-11"
+inline std::vector<int> parseCpuList(std::string const& s)
+{
+  std::vector<int> res;
+  std::stringstream ss(s);
+  std::string tok;
+  while (std::getline(ss, tok, ',')) {
+    if (tok.empty())
+      continue;
+    auto d = tok.find('-');
+    int b  = std::atoi(tok.c_str());
+    int e  = d == std::string::npos ? b : std::atoi(tok.c_str() + d + 1);
+    for (int i = b; i <= e; ++i)
+      res.push_back(i);
+  }
+  return res;
+}
+
+inline std::string readLine(std::string const& file)
+{
+  std::ifstream in(file);
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+// the cpus this process can run on
+inline std::vector<Cpu> topology()
+{
+  std::vector<Cpu> res;
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  sched_getaffinity(0, sizeof(mask), &mask);
+  std::string sys = "/sys/devices/system/";
+  for (auto id : parseCpuList(readLine(sys + "cpu/online"))) {
+    if (!CPU_ISSET(id, &mask))
+      continue;
+    auto dir      = sys + "cpu/cpu" + std::to_string(id) + "/topology/";
+    auto siblings = parseCpuList(readLine(dir + "thread_siblings_list"));
+    Cpu c;
+    c.id     = id;
+    c.socket = std::atoi(readLine(dir + "physical_package_id").c_str());
+    c.core   = std::atoi(readLine(dir + "core_id").c_str());
+    c.thread =
+        std::find(siblings.begin(), siblings.end(), id) - siblings.begin();
+    c.node   = 0;
+    res.push_back(c);
+  }
+  // no numa support in the kernel: all in node 0
+  for (int n = 0; n < 1024; ++n) {
+    auto list = readLine(sys + "node/node" + std::to_string(n) + "/cpulist");
+    if (list.empty())
+      break;
+    for (auto id : parseCpuList(list))
+      for (auto& c : res)
+        if (c.id == id)
+          c.node = n;
+  }
+  return res;
+}
+
+enum class Pinning
+{
+  None,
+  Compact,
+  Scatter,
+  Cores,
+  SMT,
+  Node
+};
+
+// false for an unknown name (p unchanged)
+inline bool pinning(std::string const& s, Pinning& p)
+{
+  static std::pair<char const*, Pinning> const names[] = {
+      {"none", Pinning::None},
+      {"compact", Pinning::Compact},
+      {"scatter", Pinning::Scatter},
+      {"cores", Pinning::Cores},
+      {"smt", Pinning::SMT},
+      {"node", Pinning::Node}};
+  for (auto const& n : names)
+    if (s == n.first) {
+      p = n.second;
+      return true;
+    }
+  return false;
+}
+
+// the cpus in the order threads are placed on them
+inline std::vector<int> placement(std::vector<Cpu> cpus, Pinning p, int node)
+{
+  using Key = std::tuple<int, int, int>;
+  std::function<Key(Cpu const&)> key;
+  switch (p) {
+  case Pinning::Scatter:
+    key = [](Cpu const& c) { return Key(c.thread, c.core, c.socket); };
+    break;
+  case Pinning::SMT:
+    key = [](Cpu const& c) { return Key(c.socket, c.core, c.thread); };
+    break;
+  case Pinning::Cores:
+    cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+                              [](Cpu const& c) { return c.thread > 0; }),
+               cpus.end());
+    key = [](Cpu const& c) { return Key(c.socket, c.core, 0); };
+    break;
+  case Pinning::Node:
+    cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+                              [=](Cpu const& c) { return c.node != node; }),
+               cpus.end());
+    key = [](Cpu const& c) { return Key(c.thread, c.socket, c.core); };
+    break;
+  default:
+    key = [](Cpu const& c) { return Key(c.socket, c.thread, c.core); };
+  }
+  std::stable_sort(cpus.begin(), cpus.end(), [&](Cpu const& a, Cpu const& b) {
+    return key(a) < key(b);
+  });
+  std::vector<int> res;
+  for (auto const& c : cpus)
+    res.push_back(c.id);
+  return res;
+}
+
+struct ScalingOptions
+{
+  std::string pin = "compact";
+  int node        = 0;
+  int maxThreads  = 0; // 0: all the cpus of the policy
+  int reps        = 5;
+  bool all        = false;
+
+  // false, with a message, for an unknown --pin
+  bool parse(int argc, char** argv)
+  {
+    for (int i = 1; i < argc; ++i) {
+      std::string a = argv[i];
+      auto eq       = a.find('=');
+      auto val = eq == std::string::npos ? std::string() : a.substr(eq + 1);
+      if (a.compare(0, 6, "--pin=") == 0)
+        pin = val;
+      else if (a.compare(0, 7, "--node=") == 0)
+        node = std::atoi(val.c_str());
+      else if (a.compare(0, 14, "--max-threads=") == 0)
+        maxThreads = std::atoi(val.c_str());
+      else if (a.compare(0, 7, "--reps=") == 0)
+        reps = std::max(1, std::atoi(val.c_str()));
+      else if (a == "--threads=all")
+        all = true;
+    }
+    Pinning p;
+    if (!pinning(pin, p)) {
+      std::cerr << "error: unknown --pin=" << pin
+                << " (none, compact, scatter, cores, smt or node)" << std::endl;
+      return false;
+    }
+    return true;
+  }
+};
+
+struct ScalingPoint
+{
+  int threads;
+  double ns; // median over the reps
+  double speedup;
+  double efficiency;
+  double gflops;
+  double gbs;
+};
+
+using Work = std::function<void(int tid, int nThreads)>;
+
+// median time of a run of work on the given cpus
+inline double timeOn(std::vector<int> const& cpus, int n, bool doPin,
+                     Work const& work, Work const& setup, int reps)
+{
+  using Clock = std::chrono::steady_clock;
+  SpinBarrier barrier(n);
+  std::vector<double> t;
+  auto body = [&](int tid) {
+    if (doPin && !cpus.empty())
+      pin(cpus[tid % cpus.size()]);
+    if (setup)
+      setup(tid, n);
+    // the first run is the warmup
+    for (int r = 0; r <= reps; ++r) {
+      barrier.wait();
+      auto t0 = Clock::now();
+      work(tid, n);
+      barrier.wait();
+      if (tid == 0 && r > 0)
+        t.push_back(std::chrono::duration<double, std::nano>(Clock::now() - t0)
+                        .count());
+    }
+  };
+  std::vector<std::thread> pool;
+  for (int tid = 1; tid < n; ++tid)
+    pool.emplace_back(body, tid);
+  // the main thread is thread 0: keep its affinity
+  cpu_set_t mask;
+  sched_getaffinity(0, sizeof(mask), &mask);
+  body(0);
+  sched_setaffinity(0, sizeof(mask), &mask);
+  for (auto& th : pool)
+    th.join();
+  std::sort(t.begin(), t.end());
+  return t[t.size() / 2];
+}
+
+// bytes and flops of a whole run (all threads together)
+inline std::vector<ScalingPoint> scaling(std::ostream& co,
+                                         std::string const& name,
+                                         Work const& work, double bytes,
+                                         double flops,
+                                         ScalingOptions const& opt,
+                                         Work const& setup = Work())
+{
+  auto policy = Pinning::Compact;
+  pinning(opt.pin, policy);
+  auto topo   = topology();
+  auto cpus   = placement(topo, policy, opt.node);
+  int maxN    = opt.maxThreads > 0 ? opt.maxThreads : int(cpus.size());
+  maxN        = std::max(1, maxN);
+  std::vector<int> counts;
+  for (int n = 1; n < maxN; n = opt.all ? n + 1 : 2 * n)
+    counts.push_back(n);
+  counts.push_back(maxN);
+
+  co << name << ": pinning " << opt.pin << " on cpus";
+  for (auto c : cpus)
+    co << ' ' << c;
+  if (maxN > int(cpus.size()))
+    co << "  (oversubscribed)";
+  co << std::endl;
+  co << "threads       time ms  speedup  efficiency     GFLOP/s        GB/s"
+        "   GB/s/thread"
+     << std::endl;
+
+  std::vector<ScalingPoint> res;
+  char buf[256];
+  for (auto n : counts) {
+    ScalingPoint p;
+    p.threads = n;
+    p.ns = timeOn(cpus, n, policy != Pinning::None, work, setup, opt.reps);
+    p.speedup    = res.empty() ? 1. : res.front().ns / p.ns;
+    p.efficiency = p.speedup / n;
+    p.gflops     = flops / p.ns;
+    p.gbs        = bytes / p.ns;
+    snprintf(buf, sizeof(buf), "%7d %13.4g %8.2f %10.1f%% %11.4g %11.4g %13.4g",
+             n, 1.e-6 * p.ns, p.speedup, 100. * p.efficiency, p.gflops, p.gbs,
+             p.gbs / n);
+    co << buf << std::endl;
+    res.push_back(p);
+  }
+  return res;
+}
+
+// thread tid of nThreads processes [begin, end)
+inline std::pair<long long, long long> share(long long n, int tid, int nThreads)
+{
+  return {n * tid / nThreads, n * (tid + 1) / nThreads};
+}
+
+// the pages fully inside [b, e) go back to the OS (content is lost):
+// the next write allocates them on the node of the writing thread
+inline void releasePages(void* b, void* e)
+{
+  auto page = std::uintptr_t(sysconf(_SC_PAGESIZE));
+  auto pb   = (std::uintptr_t(b) + page - 1) & ~(page - 1);
+  auto pe   = std::uintptr_t(e) & ~(page - 1);
+  if (pe > pb)
+    madvise((void*)pb, pe - pb, MADV_DONTNEED);
+}
+
+} // namespace benchmark
+
+#endif
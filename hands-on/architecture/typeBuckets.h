@@ -0,0 +1,93 @@
+#ifndef TYPE_BUCKETS_H
+#define TYPE_BUCKETS_H
+//
+//  a polymorphic container for a closed set of types: each type in its own
+//  contiguous array (a "bucket"), no pointers and no virtual calls when
+//  iterating
+//
+//    buckets::Buckets<B, C> v;
+//    v.push_back(C(3.14));
+//    v.emplace_back<B>(7.1);
+//    v.for_each([&](auto const& x) { c += x.comp(); });
+//
+//  for_each runs one loop per type, in the order of the template arguments:
+//  inside the loop the type is known at compile time, the call is direct (or
+//  inlined, or vectorized) and there is nothing to predict. The price is the
+//  order: the elements come grouped by type, not in insertion order.
+//
+//  the elements are exactly of their type (no slicing, no derived objects):
+//  comp() of a final class is a direct call, otherwise write x.T::comp()
+//  or make the class final. See Virtual.cpp (USE_BUCKETS)
+//
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace buckets {
+
+template<typename... Ts>
+class Buckets
+{
+public:
+  template<typename T>
+  void push_back(T&& x)
+  {
+    bucket<std::decay_t<T>>().push_back(std::forward<T>(x));
+  }
+
+  template<typename T, typename... Args>
+  T& emplace_back(Args&&... args)
+  {
+    return bucket<T>().emplace_back(std::forward<Args>(args)...);
+  }
+
+  template<typename T>
+  std::vector<T>& bucket()
+  {
+    return std::get<std::vector<T>>(v_);
+  }
+  template<typename T>
+  std::vector<T> const& bucket() const
+  {
+    return std::get<std::vector<T>>(v_);
+  }
+
+  std::size_t size() const
+  {
+    return (bucket<Ts>().size() + ...);
+  }
+
+  void clear()
+  {
+    (bucket<Ts>().clear(), ...);
+  }
+
+  // f(x) for each element, one loop per type
+  template<typename F>
+  void for_each(F&& f)
+  {
+    (forEach(bucket<Ts>(), f), ...);
+  }
+  template<typename F>
+  void for_each(F&& f) const
+  {
+    (forEach(bucket<Ts>(), f), ...);
+  }
+
+private:
+  template<typename V, typename F>
+  static void forEach(V& v, F& f)
+  {
+    for (auto& x : v)
+      f(x);
+  }
+
+  std::tuple<std::vector<Ts>...> v_;
+};
+
+} // namespace buckets
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef VEC3_SOA_H
+#define VEC3_SOA_H
+//
+//  a batch of 3D vectors stored SoA (all the x, then all the y, then all the
+//  z) and the usual operations on all of them, a native vector of elements
+//  at a time (see backendSol.cpp for the AoS version of backend.cpp)
+//
+//    vec3::Batch<double> p(n), q(n), r(n);
+//    p.set(i, x, y, z);
+//    vec3::normalize(p, r);        // r = p / |p|
+//    vec3::cross(p, q, r);         // r = p x q
+//    vec3::scaleAdd(s, p, q, r);   // r = s p + q
+//
+//  the arrays are padded (with zeros) to a multiple of 64 bytes: the
+//  kernels writing a Batch have no scalar tail. The padding is computed as
+//  well and its results (0/0 for normalize) are never read. norm and dot
+//  write to a plain array of size() elements: they stop the vectors there
+//  and compute the last elements (less than a native vector) one by one
+//
+
+#include "gemm.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace vec3 {
+
+// sqrt of each lane
+template<typename V>
+inline V sqrt(V v)
+{
+  for (std::size_t l = 0; l < sizeof(V) / sizeof(v[0]); ++l)
+    v[l] = std::sqrt(v[l]);
+  return v;
+}
+#ifdef __AVX512F__
+inline gemm::Native<float, 64>::V sqrt(gemm::Native<float, 64>::V v)
+{
+  return (gemm::Native<float, 64>::V)_mm512_sqrt_ps((__m512)v);
+}
+inline gemm::Native<double, 64>::V sqrt(gemm::Native<double, 64>::V v)
+{
+  return (gemm::Native<double, 64>::V)_mm512_sqrt_pd((__m512d)v);
+}
+#endif
+#ifdef __AVX__
+inline gemm::Native<float, 32>::V sqrt(gemm::Native<float, 32>::V v)
+{
+  return (gemm::Native<float, 32>::V)_mm256_sqrt_ps((__m256)v);
+}
+inline gemm::Native<double, 32>::V sqrt(gemm::Native<double, 32>::V v)
+{
+  return (gemm::Native<double, 32>::V)_mm256_sqrt_pd((__m256d)v);
+}
+#endif
+#ifdef __SSE2__
+inline gemm::Native<float, 16>::V sqrt(gemm::Native<float, 16>::V v)
+{
+  return (gemm::Native<float, 16>::V)_mm_sqrt_ps((__m128)v);
+}
+inline gemm::Native<double, 16>::V sqrt(gemm::Native<double, 16>::V v)
+{
+  return (gemm::Native<double, 16>::V)_mm_sqrt_pd((__m128d)v);
+}
+#endif
+
+template<typename T>
+class Batch
+{
+public:
+  // the arrays are a multiple of this (the widest native vector)
+  static constexpr std::size_t Pad = 64 / sizeof(T);
+
+  explicit Batch(std::size_t n)
+      : n_(n)
+      , x_((n + Pad - 1) / Pad * Pad)
+      , y_(x_.size())
+      , z_(x_.size())
+  {}
+
+  std::size_t size() const
+  {
+    return n_;
+  }
+  // including the padding
+  std::size_t paddedSize() const
+  {
+    return x_.size();
+  }
+
+  void set(std::size_t i, T x, T y, T z)
+  {
+    x_[i] = x;
+    y_[i] = y;
+    z_[i] = z;
+  }
+
+  T* x()
+  {
+    return x_.data();
+  }
+  T* y()
+  {
+    return y_.data();
+  }
+  T* z()
+  {
+    return z_.data();
+  }
+  T const* x() const
+  {
+    return x_.data();
+  }
+  T const* y() const
+  {
+    return y_.data();
+  }
+  T const* z() const
+  {
+    return z_.data();
+  }
+
+private:
+  std::size_t n_;
+  std::vector<T> x_, y_, z_;
+};
+
+// f(i) for each native vector of elements, from i
+template<typename T, int VB = gemm::nativeBytes, typename F>
+inline void forEach(Batch<T> const& a, F f)
+{
+  constexpr std::size_t W = gemm::Native<T, VB>::size;
+  for (std::size_t i = 0; i < a.paddedSize(); i += W)
+    f(i);
+}
+
+// f(i) for each native vector of elements within size(), then tail(i) for
+// each of the elements left
+template<typename T, int VB = gemm::nativeBytes, typename F, typename G>
+inline void forEach(Batch<T> const& a, F f, G tail)
+{
+  constexpr std::size_t W = gemm::Native<T, VB>::size;
+  std::size_t i           = 0;
+  for (; i + W <= a.size(); i += W)
+    f(i);
+  for (; i < a.size(); ++i)
+    tail(i);
+}
+
+// out[i] = |a[i]|, out of size() elements
+template<typename T, int VB = gemm::nativeBytes>
+void norm(Batch<T> const& a, T* out)
+{
+  using NT = gemm::Native<T, VB>;
+  forEach<T, VB>(
+      a,
+      [&](std::size_t i) {
+        auto x = NT::load(a.x() + i), y = NT::load(a.y() + i),
+             z = NT::load(a.z() + i);
+        NT::store(out + i, sqrt(x * x + y * y + z * z));
+      },
+      [&](std::size_t i) {
+        auto x = a.x()[i], y = a.y()[i], z = a.z()[i];
+        out[i] = std::sqrt(x * x + y * y + z * z);
+      });
+}
+
+// out = a / |a|: one reciprocal of the norm per element
+template<typename T, int VB = gemm::nativeBytes>
+void normalize(Batch<T> const& a, Batch<T>& out)
+{
+  using NT = gemm::Native<T, VB>;
+  forEach<T, VB>(a, [&](std::size_t i) {
+    auto x = NT::load(a.x() + i), y = NT::load(a.y() + i),
+         z = NT::load(a.z() + i);
+    auto r = T(1) / sqrt(x * x + y * y + z * z);
+    NT::store(out.x() + i, x * r);
+    NT::store(out.y() + i, y * r);
+    NT::store(out.z() + i, z * r);
+  });
+}
+
+// out[i] = a[i] . b[i], out of size() elements
+template<typename T, int VB = gemm::nativeBytes>
+void dot(Batch<T> const& a, Batch<T> const& b, T* out)
+{
+  using NT = gemm::Native<T, VB>;
+  forEach<T, VB>(
+      a,
+      [&](std::size_t i) {
+        NT::store(out + i, NT::load(a.x() + i) * NT::load(b.x() + i)
+                               + NT::load(a.y() + i) * NT::load(b.y() + i)
+                               + NT::load(a.z() + i) * NT::load(b.z() + i));
+      },
+      [&](std::size_t i) {
+        out[i] = a.x()[i] * b.x()[i] + a.y()[i] * b.y()[i]
+               + a.z()[i] * b.z()[i];
+      });
+}
+
+// out = a x b
+template<typename T, int VB = gemm::nativeBytes>
+void cross(Batch<T> const& a, Batch<T> const& b, Batch<T>& out)
+{
+  using NT = gemm::Native<T, VB>;
+  forEach<T, VB>(a, [&](std::size_t i) {
+    auto ax = NT::load(a.x() + i), ay = NT::load(a.y() + i),
+         az = NT::load(a.z() + i);
+    auto bx = NT::load(b.x() + i), by = NT::load(b.y() + i),
+         bz = NT::load(b.z() + i);
+    NT::store(out.x() + i, ay * bz - az * by);
+    NT::store(out.y() + i, az * bx - ax * bz);
+    NT::store(out.z() + i, ax * by - ay * bx);
+  });
+}
+
+// out = s a + b
+template<typename T, int VB = gemm::nativeBytes>
+void scaleAdd(T s, Batch<T> const& a, Batch<T> const& b, Batch<T>& out)
+{
+  using NT = gemm::Native<T, VB>;
+  forEach<T, VB>(a, [&](std::size_t i) {
+    NT::store(out.x() + i, s * NT::load(a.x() + i) + NT::load(b.x() + i));
+    NT::store(out.y() + i, s * NT::load(a.y() + i) + NT::load(b.y() + i));
+    NT::store(out.z() + i, s * NT::load(a.z() + i) + NT::load(b.z() + i));
+  });
+}
+
+} // namespace vec3
+
+#endif
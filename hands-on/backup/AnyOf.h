@@ -1,198 +1,181 @@
 #ifndef ANYOF_H
 #define ANYOF_H
 //
-//  a simple class to store in place Objects from types derived from a common
-//  base type multiple inheritance is not supported relies on the base type to
-//  have a virtual destructor It does not have any additional memory or time
-//  overhead w/r/t in place new and static_cast
+//  a simple class to store in place objects of one of the types C... derived
+//  from a common base type P (single inheritance, the base at the start of
+//  the object): a std::variant whose alternatives can also be used through
+//  their base
 //
+//    using BorC = AnyOf<Base, B, C>;
+//    BorC a(C(3.14));                    // or a.emplace<B>(7.1)
+//    a().comp();                         // virtual call through the base
+//    a.visit([](auto& x) { x.comp(); });  // x is a B& or a C&: direct call
 //
+//  visit dispatches through a table of one function per type, built at
+//  compile time and indexed by the stored type: one indirect jump, no
+//  comparison of a "type" member, and no heap allocation
+//
+//  AnyOfVector is a std::vector of them that can be grouped by type, in
+//  place, before a hot loop: for_each then runs one loop per type, each of
+//  them with the type known at compile time (see VirtualAny.cpp)
 //
 
-#include <cassert>
-#include <cmath>
-#include <cstring>
-#include <functional>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <new>
 #include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace any_details {
 
-template<typename T>
-inline constexpr T vmax(T a, T b)
+template<typename T, typename... C>
+constexpr int index()
 {
-  return (a > b) ? a : b;
+  int i = 0, r = -1;
+  ((std::is_same<T, C>::value ? (r = i, ++i) : ++i), ...);
+  return r;
 }
 
-template<class TupleType, int N = std::tuple_size<TupleType>::value>
-struct maxSizeT
-{
-  typedef typename std::tuple_element<N - 1, TupleType>::type Elem;
-  enum
-  {
-    valueSize =
-        vmax(sizeof(Elem),
-             (long unsigned int)(maxSizeT<TupleType, N - 1>::valueSize)),
-    valueAlign =
-        vmax(alignof(Elem),
-             (long unsigned int)(maxSizeT<TupleType, N - 1>::valueAlign))
-  };
-};
-
-template<class TupleType>
-struct maxSizeT<TupleType, 0>
-{
-  enum
-  {
-    valueSize  = sizeof(typename std::tuple_element<0, TupleType>::type),
-    valueAlign = alignof(typename std::tuple_element<0, TupleType>::type)
-  };
-};
-
-template<typename TupleType, typename S,
-         int i = std::tuple_size<TupleType>::value - 1>
-struct tuple_index
+template<typename... C>
+constexpr std::size_t maxSize()
 {
-  enum
-  {
-    value =
-        std::is_same<typename std::tuple_element<i, TupleType>::type, S>::value
-            ? i
-            : tuple_index<TupleType, S, i - 1>::value
-  };
-};
-
-template<typename TupleType, typename S>
-struct tuple_index<TupleType, S, -1>
-{
-  enum
-  {
-    value = -1
-  };
-};
-
-template<class Head, typename... Tail>
-struct maxSize
-{
-  enum
-  {
-    valueSize =
-        vmax(sizeof(Head), (long unsigned int)(maxSize<Tail...>::valueSize)),
-    valueAlign =
-        vmax(alignof(Head), (long unsigned int)(maxSize<Tail...>::valueAlign)),
-  };
-};
+  return std::max({sizeof(C)...});
+}
 
-template<class T>
-struct maxSize<T>
+template<typename... C>
+constexpr std::size_t maxAlign()
 {
-  enum
-  {
-    valueSize  = sizeof(T),
-    valueAlign = alignof(T)
-  };
-};
+  return std::max({alignof(C)...});
+}
 
 } // namespace any_details
 
 template<typename P, typename... C>
 struct AnyOf
 {
-  // using aligned_union_t = typename std::aligned_union<4,C...>::type;
-  enum
-  {
-    size  = any_details::maxSize<C...>::valueSize,
-    align = any_details::maxSize<C...>::valueAlign
-  };
-  using aligned_union_t = typename std::aligned_storage<size, align>::type;
+  static_assert((std::is_base_of<P, C>::value && ...),
+                "all types must derive from P");
 
-  bool empty() const
+  static constexpr int ntypes = sizeof...(C);
+
+  // the position of T in C..., -1 if not there
+  template<typename T>
+  static constexpr int indexOf = any_details::index<T, C...>();
+
+  AnyOf() noexcept
+  {}
+
+  template<typename T, typename... Args>
+  explicit AnyOf(std::in_place_type_t<T>, Args&&... args)
   {
-    void* vtp;
-    memcpy(&vtp, &mem, sizeof(vtp));
-    return nullptr == vtp;
+    emplace<T>(std::forward<Args>(args)...);
   }
-  void zeroit()
+
+  template<typename T,
+           typename = std::enable_if_t<indexOf<std::decay_t<T>> >= 0>>
+  explicit AnyOf(T&& t)
   {
-    void* vtp = nullptr;
-    memcpy(&mem, &vtp, sizeof(vtp));
+    emplace<std::decay_t<T>>(std::forward<T>(t));
   }
 
-  AnyOf()
+  AnyOf(AnyOf const& rh)
   {
-    zeroit();
+    if (!rh.empty())
+      rh.visit(
+          [this](auto const& x) { emplace<std::decay_t<decltype(x)>>(x); });
   }
 
-  /* does not teally work
-  template<typename T>
-  struct Tag { using type=T;};
-  template<typename T, typename ... Args>
-  AnyOf(T, Args&&... args){
-    new(get()) typename T::type(std::forward<Args...>(args...));
+  AnyOf(AnyOf&& rh) noexcept
+  {
+    if (!rh.empty())
+      rh.visit([this](auto& x) {
+        emplace<std::decay_t<decltype(x)>>(std::move(x));
+      });
+    rh.destroy();
   }
-  */
 
-  void destroy()
+  AnyOf& operator=(AnyOf const& rh)
   {
-    if (!empty())
-      get()->~P();
+    if ((&rh) == this)
+      return *this;
+    destroy();
+    if (!rh.empty())
+      rh.visit(
+          [this](auto const& x) { emplace<std::decay_t<decltype(x)>>(x); });
+    return *this;
   }
-  template<typename T>
-  explicit AnyOf(T const& t) noexcept
+
+  AnyOf& operator=(AnyOf&& rh) noexcept
   {
-    new (get()) T(t);
+    if ((&rh) == this)
+      return *this;
+    destroy();
+    if (!rh.empty())
+      rh.visit([this](auto& x) {
+        emplace<std::decay_t<decltype(x)>>(std::move(x));
+      });
+    rh.destroy();
+    return *this;
   }
 
-  template<typename T>
-  explicit AnyOf(T&& t) noexcept
+  ~AnyOf()
   {
-    new (get()) T(std::move(t));
+    destroy();
   }
-  template<typename T>
-  void reset(T const& t) noexcept
+
+  template<typename T, typename... Args>
+  T& emplace(Args&&... args)
   {
+    static_assert(indexOf<T> >= 0, "not one of the types");
     destroy();
-    new (get()) T(t);
+    auto p = new (&mem) T(std::forward<Args>(args)...);
+    index_ = indexOf<T>;
+    return *p;
   }
+
   template<typename T>
-  void reset(T&& t) noexcept
+  void reset(T&& t)
   {
-    destroy();
-    new (get()) T(std::move(t));
+    emplace<std::decay_t<T>>(std::forward<T>(t));
   }
 
-  AnyOf(AnyOf&& rh) noexcept
-      : mem(std::move(rh.mem))
+  void destroy() noexcept
   {
-    rh.zeroit();
+    if (!empty())
+      visit([](auto& x) {
+        using T = std::decay_t<decltype(x)>;
+        x.~T();
+      });
+    index_ = -1;
   }
 
-  AnyOf& operator=(AnyOf&& rh) noexcept
+  bool empty() const
   {
-    if ((&rh) == this)
-      return *this;
-    destroy();
-    mem = std::move(rh.mem);
-    rh.zeroit();
-    return *this;
+    return index_ < 0;
   }
-
-  ~AnyOf()
+  int index() const
   {
-    destroy();
+    return index_;
+  }
+  template<typename T>
+  bool holds() const
+  {
+    return index_ == indexOf<T>;
   }
-  AnyOf(AnyOf const&) = delete;
-  AnyOf& operator=(AnyOf const&) = delete;
 
+  // no check: T must be P or the type stored
   template<typename T = P>
   T* get()
   {
-    return (T*)&mem;
+    return std::launder(reinterpret_cast<T*>(&mem));
   }
   template<typename T = P>
   T const* get() const
   {
-    return (T const*)&mem;
+    return std::launder(reinterpret_cast<T const*>(&mem));
   }
   P& operator()()
   {
@@ -202,7 +185,136 @@ struct AnyOf
   {
     return *get();
   }
-  aligned_union_t mem;
+
+  // f(x) with x the object as its own type (not empty)
+  template<typename F>
+  decltype(auto) visit(F&& f)
+  {
+    return dispatch<AnyOf&>(*this, f);
+  }
+  template<typename F>
+  decltype(auto) visit(F&& f) const
+  {
+    return dispatch<AnyOf const&>(*this, f);
+  }
+
+  alignas(any_details::maxAlign<C...>())
+      unsigned char mem[any_details::maxSize<C...>()];
+
+private:
+  template<typename Self, typename F>
+  static decltype(auto) dispatch(Self self, F& f)
+  {
+    using R = decltype(f(*self.template get<
+                         std::tuple_element_t<0, std::tuple<C...>>>()));
+    using Fn = R (*)(Self, F&);
+    // one entry per type, the jump table of a switch on index_
+    static constexpr Fn table[] = {[](Self s, F& g) -> R {
+      return g(*s.template get<C>());
+    }...};
+    return table[self.index_](self, f);
+  }
+
+  int index_ = -1;
+};
+
+template<typename P, typename... C>
+class AnyOfVector
+{
+public:
+  using value_type = AnyOf<P, C...>;
+
+  template<typename T>
+  void push_back(T&& t)
+  {
+    v_.emplace_back(std::forward<T>(t));
+    grouped_ = false;
+  }
+
+  template<typename T, typename... Args>
+  T& emplace_back(Args&&... args)
+  {
+    grouped_ = false;
+    return *v_.emplace_back(std::in_place_type<T>, std::forward<Args>(args)...)
+                .template get<T>();
+  }
+
+  void reserve(std::size_t n)
+  {
+    v_.reserve(n);
+  }
+  std::size_t size() const
+  {
+    return v_.size();
+  }
+  value_type& operator[](std::size_t i)
+  {
+    grouped_ = false; // may be reset to another type
+    return v_[i];
+  }
+  value_type const& operator[](std::size_t i) const
+  {
+    return v_[i];
+  }
+  auto begin() const
+  {
+    return v_.begin();
+  }
+  auto end() const
+  {
+    return v_.end();
+  }
+
+  // reorder in place: all the elements of the first type, then the
+  // second... (in their original order within each type)
+  void group()
+  {
+    std::stable_sort(v_.begin(), v_.end(),
+                     [](value_type const& a, value_type const& b) {
+                       return a.index() < b.index();
+                     });
+    std::size_t i = 0;
+    for (int t = 0; t < value_type::ntypes; ++t) {
+      begin_[t] = i;
+      while (i < v_.size() && v_[i].index() == t)
+        ++i;
+    }
+    begin_[value_type::ntypes] = i;
+    grouped_                   = true;
+  }
+  bool grouped() const
+  {
+    return grouped_;
+  }
+
+  // f(x) for each element as its own type: one loop per type if grouped,
+  // otherwise one visit (jump) per element
+  template<typename F>
+  void for_each(F&& f) const
+  {
+    if (grouped_)
+      forEachGrouped(f, std::index_sequence_for<C...>{});
+    else
+      for (auto const& a : v_)
+        a.visit(f);
+  }
+
+private:
+  template<typename F, std::size_t... I>
+  void forEachGrouped(F& f, std::index_sequence<I...>) const
+  {
+    (forEachOf<C>(f, begin_[I], begin_[I + 1]), ...);
+  }
+  template<typename T, typename F>
+  void forEachOf(F& f, std::size_t b, std::size_t e) const
+  {
+    for (auto i = b; i < e; ++i)
+      f(*v_[i].template get<T>());
+  }
+
+  std::vector<value_type> v_;
+  std::array<std::size_t, sizeof...(C) + 1> begin_{};
+  bool grouped_ = false;
 };
 
 #endif
@@ -6,9 +6,7 @@
 //  add -DESTRIN to switch to ESTRIN evaluation
 //
 
-#include "benchmark.h"
-#include <chrono>
-#include <iostream>
+#include "../architecture/benchRunner.h"
 
 // degree 6 polynomial (from "exp" expansion)
 inline float poly6(float y)
@@ -53,12 +51,8 @@ float* alloc(int N)
   return new float[N];
 }
 
-int main()
+void polyKernel(benchmark::State& st)
 {
-  using namespace std;
-  auto start = chrono::high_resolution_clock::now();
-  auto delta = start - start;
-
   int N = 1024;
 
   int size = N * 8; // 64;
@@ -67,16 +61,19 @@ int main()
 
   init(a, size, 1.3458f);
 
-  for (int j = 0; j < 500000; ++j) {
-    delta -= (chrono::high_resolution_clock::now() - start);
+  st.setItems(size);
+  st.setFlops(12. * size);
+  st.setBytes(2. * size * sizeof(float));
+  while (st.next()) {
     benchmark::touch(a);
     comp(r, a, size);
     benchmark::keep(r);
-    delta += (chrono::high_resolution_clock::now() - start);
   }
-  std::cout << " Computation took "
-            << chrono::duration_cast<chrono::milliseconds>(delta).count()
-            << " ms" << std::endl;
 
-  return 0;
+  delete[] a;
+  delete[] r;
 }
+
+BENCHMARK(polyKernel);
+
+BENCHMARK_MAIN()
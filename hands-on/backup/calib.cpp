@@ -1,9 +1,7 @@
-#include "benchmark.h"
+#include "../architecture/benchRunner.h"
 #include <algorithm>
 #include <array>
 #include <cassert>
-#include <chrono>
-#include <iostream>
 #include <memory>
 #include <random>
 #include <tuple>
@@ -15,12 +13,17 @@ std::uniform_real_distribution<float> pgen(32.f, 64.f);
 std::uniform_int_distribution<> cgen(2, 997);
 std::uniform_real_distribution<float> egen(128.f, 64000.f);
 
-int main()
-{
-  using namespace std;
-  auto start = chrono::high_resolution_clock::now();
-  auto delta = start - start;
+//
+//  calibration of sparse cells: the cost is dominated by cache misses on the
+//  two matrices, so compare
+//    ./a.out --cache=warm    (all in cache, as in a tight benchmark loop)
+//    ./a.out --cache=cold    (ped, calib and cells flushed before each sample)
+//    ./a.out --cache=thrash  (LLC evicted, the old -DTRASH)
+//  add -DPREF to prefetch the cells 25 ahead
+//
 
+void calibKernel(benchmark::State& st)
+{
   constexpr int N = 1000;
 
   using Matrix = std::array<std::array<float, N>, N>;
@@ -38,48 +41,51 @@ int main()
   auto const& ped = *pPed;
   benchmark::keep(ped);
 
-  // trash the cache
-#ifdef TRASH
-  auto cs = std::vector<char>(100 * 1000 * 1000);
-  for (auto& c : cs)
-    c = 'a';
-#endif
-
   constexpr int nc = 400;
   using Cell       = std::tuple<short, short, float>;
-  std::vector<Cell> data(nc * 25);
+  std::vector<Cell> input(nc * 25);
   int s = 0;
   for (int i = 0; i < nc; ++i) {
     auto x = cgen(eng);
     auto y = cgen(eng);
     for (int j = x - 2; j < x + 3; ++j)
       for (int k = y - 2; k < y + 3; ++k)
-        data[s++] = Cell(j, k, egen(eng));
+        input[s++] = Cell(j, k, egen(eng));
   }
-  assert(s == int(data.size()));
-  //  std::sort(data.begin(),data.end(),[](Cell a, Cell b){ return a<b;});
+  assert(s == int(input.size()));
+  //  std::sort(input.begin(),input.end(),[](Cell a, Cell b){ return a<b;});
+
+  auto data = input;
+  st.addWorkingSet(&ped, sizeof(Matrix));
+  st.addWorkingSet(&calib, sizeof(Matrix));
+  st.addWorkingSet(data.data(), data.size() * sizeof(Cell));
+  st.setItems(data.size());
+  st.setFlops(2 * data.size());
+  st.setBytes(data.size() * (2 * sizeof(Cell) + 2 * 64),
+              2 * sizeof(Matrix) + data.size() * sizeof(Cell));
 
-  delta += (chrono::high_resolution_clock::now() - start);
-  benchmark::keep(data);
   int kp = 5;
   benchmark::keep(kp);
-  for (auto& cell : data) {
+  while (st.next()) {
+    st.pause();
+    std::copy(input.begin(), input.end(), data.begin());
+    benchmark::keep(data);
+    st.resume();
+    for (auto& cell : data) {
 #ifdef PREF
-    //    if (kp++ == 5) { kp=0;
-    auto const& plus10 = *((&cell) + 25);
-    __builtin_prefetch((&ped[std::get<0>(plus10)][std::get<1>(plus10)]));
-    __builtin_prefetch((&calib[std::get<0>(plus10)][std::get<1>(plus10)]));
+      //    if (kp++ == 5) { kp=0;
+      auto const& plus10 = *((&cell) + 25);
+      __builtin_prefetch((&ped[std::get<0>(plus10)][std::get<1>(plus10)]));
+      __builtin_prefetch((&calib[std::get<0>(plus10)][std::get<1>(plus10)]));
 //    }
 #endif
-    std::get<2>(cell) =
-        (std::get<2>(cell) - ped[std::get<0>(cell)][std::get<1>(cell)])
-        * calib[std::get<0>(cell)][std::get<1>(cell)];
+      std::get<2>(cell) =
+          (std::get<2>(cell) - ped[std::get<0>(cell)][std::get<1>(cell)])
+          * calib[std::get<0>(cell)][std::get<1>(cell)];
+    }
+    benchmark::keep(data);
   }
-  benchmark::keep(data);
-  delta += (chrono::high_resolution_clock::now() - start);
-  std::cout << " Computation took "
-            << chrono::duration_cast<chrono::milliseconds>(delta).count()
-            << " ms" << std::endl;
-
-  return 0;
 }
+BENCHMARK(calibKernel);
+
+BENCHMARK_MAIN()
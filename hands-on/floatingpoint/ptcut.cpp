@@ -3,12 +3,7 @@
 #include<random>
 #include<cstdio>
 #include<array>
-#include <x86intrin.h>
-
-inline unsigned long long refClock() {
-  unsigned int taux=0;
-  return __rdtscp(&taux);
-}
+#include "../architecture/cycleTimer.h"
 
 
 inline float pt2(float x, float y) {
@@ -58,19 +53,19 @@ int main() {
 
   {
     // reference loop
-    long long tl = -refClock();
+    benchmark::CycleTimer tl; tl.start();
     float sq=0.;
     for (int i=0;i!=NN;++i)
       sq+= x[i]+y[i];
-    tl += refClock();
+    tl.stop();
     
     if(pr)
-      printf("sum %f : %f\n",double(tl)/double(NN*ok),sq);
+      printf("sum %f cycles %f ns : %f\n",tl.cycles()/double(NN*ok),tl.ns()/double(NN*ok),sq);
   }
 
   {
     // pt cut 
-    long long tl = -refClock();
+    benchmark::CycleTimer tl; tl.start();
     constexpr float ptcut = 0.5f;
     float sq=0.;
     // #pragma omp simd reduction(+: sq)
@@ -79,10 +74,10 @@ int main() {
       if (pt(x[i],y[i])>ptcut) 
 	sq+= x[i]+y[i];
     }
-    tl += refClock();
+    tl.stop();
     
     if(pr)
-      printf("pt %f : %f\n",double(tl)/double(NN*ok),sq);
+      printf("pt %f cycles %f ns : %f\n",tl.cycles()/double(NN*ok),tl.ns()/double(NN*ok),sq);
   }
 
 
@@ -93,7 +88,7 @@ int main() {
 
  {
    // phi cut 
-   long long tl = -refClock();
+   benchmark::CycleTimer tl; tl.start();
    constexpr float phicut = 0.125f;
    float sq=0.;
    int tot =0;
@@ -103,10 +98,10 @@ int main() {
 	 { sq+= x[j]+y[j]; ++tot;}
      }
    }
-   tl += refClock();
+   tl.stop();
    
    if(pr)
-     printf("phicut %f : %f %d\n",double(tl)/double(NN*ok),sq,tot);
+     printf("phicut %f cycles %f ns : %f %d\n",tl.cycles()/double(NN*ok),tl.ns()/double(NN*ok),sq,tot);
  }
 
 
@@ -0,0 +1,298 @@
+#ifndef HIVE_H
+#define HIVE_H
+//
+//  a "hive" (or colony): an unordered container with stable addresses,
+//  O(1) insert and erase and iteration almost as fast as a vector, to
+//  replace a std::list<std::unique_ptr<T>> kept only because the elements
+//  must not move
+//
+//    hive::Hive<Point> points;
+//    auto& p = points.emplace();      // stays where it is until erased
+//    for (auto& p : points) p.x += k;
+//    points.erase(it);                // or erase(&p), slower
+//
+//  the elements live in chunks of N (a multiple of 64) that are never moved
+//  or freed (until clear()). Each chunk has a bitmap of the live slots: the
+//  iteration skips the erased ones a 64 bit word at a time (one count of
+//  trailing zeros per element, nothing for the runs of holes) and erase
+//  clears a bit and pushes the slot on a free list, reused by the next
+//  insertion. The order of iteration is the order of the slots, not of
+//  the insertions
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace hive {
+
+template<typename T, std::size_t N = 1024>
+class Hive
+{
+  static_assert(N % 64 == 0, "N must be a multiple of 64");
+  static constexpr std::size_t NW = N / 64;
+
+  struct Chunk
+  {
+    alignas(T) unsigned char mem[N * sizeof(T)];
+    std::uint64_t live[NW] = {};
+
+    T* slot(std::size_t i)
+    {
+      return reinterpret_cast<T*>(mem) + i;
+    }
+  };
+
+  // a slot: chunk and index in it
+  struct Slot
+  {
+    std::size_t chunk, index;
+  };
+
+public:
+  template<bool CONST>
+  class Iterator
+  {
+  public:
+    using H          = std::conditional_t<CONST, Hive const, Hive>;
+    using value_type = T;
+    using reference  = std::conditional_t<CONST, T const&, T&>;
+    using pointer    = std::conditional_t<CONST, T const*, T*>;
+    using difference_type   = std::ptrdiff_t;
+    using iterator_category = std::forward_iterator_tag;
+
+    // the first element from word w of chunk c
+    Iterator(H* h, std::size_t c, std::size_t w)
+        : h_(h)
+        , c_(c)
+        , w_(w)
+    {
+      if (c_ < h_->chunks_.size())
+        bits_ = h_->chunks_[c_]->live[w_];
+      seek();
+    }
+
+    reference operator*() const
+    {
+      return *p_;
+    }
+    pointer operator->() const
+    {
+      return p_;
+    }
+    Iterator& operator++()
+    {
+      bits_ &= bits_ - 1;
+      seek();
+      return *this;
+    }
+    Iterator operator++(int)
+    {
+      auto r = *this;
+      ++(*this);
+      return r;
+    }
+    bool operator==(Iterator const& rh) const
+    {
+      return p_ == rh.p_;
+    }
+    bool operator!=(Iterator const& rh) const
+    {
+      return !(*this == rh);
+    }
+
+  private:
+    friend class Hive;
+
+    std::size_t index() const
+    {
+      return w_ * 64 + __builtin_ctzll(bits_);
+    }
+
+    // to the lowest live slot left in bits_, or the next words, or end()
+    void seek()
+    {
+      auto nc = h_->chunks_.size();
+      if (c_ >= nc)
+        return;
+      while (!bits_) {
+        if (++w_ == NW) {
+          w_ = 0;
+          if (++c_ == nc) {
+            p_ = nullptr;
+            return;
+          }
+        }
+        bits_ = h_->chunks_[c_]->live[w_];
+      }
+      p_ = h_->chunks_[c_]->slot(index());
+    }
+
+    H* h_;
+    std::size_t c_, w_;
+    std::uint64_t bits_ = 0; // the live slots of word w_ not visited yet
+    pointer p_          = nullptr;
+  };
+  using iterator       = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  Hive() = default;
+  Hive(Hive&& rh) noexcept
+      : chunks_(std::move(rh.chunks_))
+      , free_(std::move(rh.free_))
+      , top_(std::exchange(rh.top_, N))
+      , size_(std::exchange(rh.size_, 0))
+  {}
+  Hive& operator=(Hive&& rh) noexcept
+  {
+    if ((&rh) == this)
+      return *this;
+    clear();
+    chunks_ = std::move(rh.chunks_);
+    free_   = std::move(rh.free_);
+    top_    = std::exchange(rh.top_, N);
+    size_   = std::exchange(rh.size_, 0);
+    return *this;
+  }
+  Hive(Hive const&) = delete;
+  Hive& operator=(Hive const&) = delete;
+  ~Hive()
+  {
+    clear();
+  }
+
+  // in an erased slot if any, otherwise after the last one
+  template<typename... Args>
+  T& emplace(Args&&... args)
+  {
+    Slot s;
+    if (!free_.empty()) {
+      s = free_.back();
+      free_.pop_back();
+    } else {
+      if (top_ == N) {
+        chunks_.emplace_back(new Chunk);
+        top_ = 0;
+      }
+      s = {chunks_.size() - 1, top_++};
+    }
+    auto& c = *chunks_[s.chunk];
+    auto p  = new (c.slot(s.index)) T(std::forward<Args>(args)...);
+    c.live[s.index / 64] |= std::uint64_t(1) << (s.index % 64);
+    ++size_;
+    return *p;
+  }
+
+  T& insert(T const& x)
+  {
+    return emplace(x);
+  }
+  T& insert(T&& x)
+  {
+    return emplace(std::move(x));
+  }
+
+  // the next element
+  iterator erase(iterator it)
+  {
+    erase(Slot{it.c_, it.index()});
+    return ++it;
+  }
+
+  // the element at p (an address given by emplace() or by an iterator):
+  // linear in the number of chunks, to find the one of p
+  void erase(T const* p)
+  {
+    for (std::size_t c = 0; c < chunks_.size(); ++c) {
+      auto b = chunks_[c]->slot(0);
+      if (p >= b && p < b + N) {
+        erase(Slot{c, std::size_t(p - b)});
+        return;
+      }
+    }
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+  bool empty() const
+  {
+    return size_ == 0;
+  }
+  // including the erased slots
+  std::size_t capacity() const
+  {
+    return chunks_.size() * N;
+  }
+
+  iterator begin()
+  {
+    return {this, 0, 0};
+  }
+  iterator end()
+  {
+    return {this, chunks_.size(), 0};
+  }
+  const_iterator begin() const
+  {
+    return {this, 0, 0};
+  }
+  const_iterator end() const
+  {
+    return {this, chunks_.size(), 0};
+  }
+
+  // f(x) for each element: the same as the loop on the iterators with the
+  // chunks and the bitmap words as the outer loops (full words are plain
+  // loops on 64 contiguous elements)
+  template<typename F>
+  void for_each(F f)
+  {
+    for (auto& c : chunks_)
+      for (std::size_t w = 0; w < NW; ++w) {
+        auto bits = c->live[w];
+        auto p    = c->slot(w * 64);
+        if (bits == ~std::uint64_t(0))
+          for (int i = 0; i < 64; ++i)
+            f(p[i]);
+        else
+          for (; bits; bits &= bits - 1)
+            f(p[__builtin_ctzll(bits)]);
+      }
+  }
+
+  void clear()
+  {
+    for (auto& x : *this)
+      x.~T();
+    chunks_.clear();
+    free_.clear();
+    top_  = N;
+    size_ = 0;
+  }
+
+private:
+  void erase(Slot s)
+  {
+    auto& c = *chunks_[s.chunk];
+    c.slot(s.index)->~T();
+    c.live[s.index / 64] &= ~(std::uint64_t(1) << (s.index % 64));
+    free_.push_back(s);
+    --size_;
+  }
+
+  std::vector<std::unique_ptr<Chunk>> chunks_;
+  std::vector<Slot> free_;
+  std::size_t top_  = N; // the first never used slot of the last chunk
+  std::size_t size_ = 0;
+};
+
+} // namespace hive
+
+#endif
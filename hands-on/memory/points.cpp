@@ -1,3 +1,7 @@
+// c++ -O2 -std=c++17 -Wall points.cpp
+//  -DHIVE               a hive (hive.h) instead of a list of unique_ptr
+//  -DERASE              erase the points not ok (40%) before the loop
+//
 #include<random>
 #include<cstdint>
 #include<algorithm>
@@ -6,6 +10,7 @@
 #include<cassert>
 #include<list>
 #include<memory>
+#include "hive.h"
 
 
 
@@ -26,7 +31,11 @@ std::uniform_real_distribution<Float> ugen(Float(-1),Float(1));
 std::uniform_int_distribution<int> igen(1,10);
 
 
+#ifndef HIVE
 using Container = std::list<std::unique_ptr<Point>>;
+#else
+using Container = hive::Hive<Point>;
+#endif
 
 Container generate() {
 
@@ -34,14 +43,29 @@ Container generate() {
   // generate
   int ntot = aGen(reng);
   for (int i=0; i<ntot; ++i) {
+#ifndef HIVE
     auto p = std::make_unique<Point>(); 
+#else
+    auto p = &cont.emplace();
+#endif
     p->x =  ugen(reng);
     p->y =  ugen(reng);
     p->z =  ugen(reng);
     auto r = igen(reng);
     p->ok = r<7;
+#ifndef HIVE
     cont.insert(cont.end(),std::move(p));
+#endif
   }
+#ifdef ERASE
+  for (auto p=cont.begin(); p!=cont.end();) {
+#ifndef HIVE
+    p = (*p)->ok ? std::next(p) : cont.erase(p);
+#else
+    p = p->ok ? std::next(p) : cont.erase(p);
+#endif
+  }
+#endif
   
   return cont;
 
@@ -62,7 +86,11 @@ int main() {
   for (int k=0; k<2000; ++k) {
     delta -= (std::chrono::high_resolution_clock::now()-start);
     for (auto & p : points) {
+#ifndef HIVE
       p->x += k;
+#else
+      p.x += k;
+#endif
     }  
    delta += (std::chrono::high_resolution_clock::now()-start);
   }
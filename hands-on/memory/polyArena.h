@@ -0,0 +1,220 @@
+#ifndef POLY_ARENA_H
+#define POLY_ARENA_H
+//
+//  objects of a class hierarchy allocated in a monotonic arena (big chunks,
+//  bump pointer, no individual free) and owned by a vector of base pointers:
+//  in place of a std::list<std::unique_ptr<Base>> (or a vector of them)
+//  where the objects are contiguous in memory, in order of creation
+//
+//  not a drop-in replacement: the loops on the elements (p->...) stay the
+//  same, but there is no insert or erase, the objects are created by
+//  emplace_back<T>() (no new, no unique_ptr), see polypoints.cpp -DARENA
+//
+//    arena::PolyVector<BasePoint> points;             // one arena
+//    arena::PolyVector<BasePoint, PointA, PointB> g;  // one arena per type
+//    auto& a = points.emplace_back<PointA>();
+//    for (auto& p : points)
+//      p->set_x(p->x() + k);
+//    g.group();  // iterate all the PointA, then all the PointB
+//
+//  with one arena per type the objects of each type are contiguous, and
+//  group() reorders the pointers so that the loop walks each arena in
+//  memory order (and the virtual calls go to the same target for long runs)
+//
+//  the objects are destroyed (through the virtual destructor of Base) and
+//  the memory released all together, by clear() or the destructor: erasing
+//  one element is not supported. The container can be moved, not copied
+//
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace arena {
+
+// bump allocation in chunks of ChunkSize bytes (or larger for a larger
+// object), freed all at once
+class Monotonic
+{
+public:
+  explicit Monotonic(std::size_t chunkSize = 1 << 16)
+      : chunkSize_(chunkSize)
+  {}
+  // the source is left empty (it must not bump into the chunks it gave)
+  Monotonic(Monotonic&& rh) noexcept
+      : chunkSize_(rh.chunkSize_)
+      , chunks_(std::move(rh.chunks_))
+      , cur_(std::exchange(rh.cur_, nullptr))
+      , left_(std::exchange(rh.left_, 0))
+  {}
+  Monotonic& operator=(Monotonic&& rh) noexcept
+  {
+    chunkSize_ = rh.chunkSize_;
+    chunks_    = std::move(rh.chunks_);
+    cur_       = std::exchange(rh.cur_, nullptr);
+    left_      = std::exchange(rh.left_, 0);
+    return *this;
+  }
+
+  void* allocate(std::size_t size, std::size_t align)
+  {
+    void* p = cur_;
+    if (!std::align(align, size, p, left_)) {
+      auto n = std::max(chunkSize_, size + align);
+      chunks_.emplace_back(new std::byte[n]);
+      p     = chunks_.back().get();
+      left_ = n;
+      std::align(align, size, p, left_);
+    }
+    cur_ = static_cast<std::byte*>(p) + size;
+    left_ -= size;
+    return p;
+  }
+
+  void release()
+  {
+    chunks_.clear();
+    cur_  = nullptr;
+    left_ = 0;
+  }
+
+  std::size_t chunks() const
+  {
+    return chunks_.size();
+  }
+
+private:
+  std::size_t chunkSize_;
+  std::vector<std::unique_ptr<std::byte[]>> chunks_;
+  void* cur_        = nullptr;
+  std::size_t left_ = 0;
+};
+
+// owning vector of Base*, the objects in one arena, or one per type in Ts
+template<typename Base, typename... Ts>
+class PolyVector
+{
+  static_assert(std::has_virtual_destructor<Base>::value,
+                "the objects are destroyed through Base");
+  static constexpr int NArenas = sizeof...(Ts) == 0 ? 1 : sizeof...(Ts);
+
+  // the arena of T
+  template<typename T>
+  static constexpr int arenaOf()
+  {
+    int i = 0, r = -1;
+    ((std::is_same<T, Ts>::value ? (r = i, ++i) : ++i), ...);
+    return sizeof...(Ts) == 0 ? 0 : r;
+  }
+
+public:
+  using value_type     = Base*;
+  using const_iterator = typename std::vector<Base*>::const_iterator;
+
+  explicit PolyVector(std::size_t chunkSize = 1 << 16)
+  {
+    for (auto& a : arena_)
+      a = Monotonic(chunkSize);
+  }
+  PolyVector(PolyVector&&) = default;
+  PolyVector& operator=(PolyVector&& rh)
+  {
+    if ((&rh) == this)
+      return *this;
+    clear();
+    p_     = std::move(rh.p_);
+    kind_  = std::move(rh.kind_);
+    arena_ = std::move(rh.arena_);
+    rh.p_.clear();
+    rh.kind_.clear();
+    return *this;
+  }
+  PolyVector(PolyVector const&) = delete;
+  PolyVector& operator=(PolyVector const&) = delete;
+  ~PolyVector()
+  {
+    clear();
+  }
+
+  template<typename T, typename... Args>
+  T& emplace_back(Args&&... args)
+  {
+    static_assert(std::is_base_of<Base, T>::value, "not a Base");
+    constexpr int a = arenaOf<T>();
+    static_assert(a >= 0, "not one of the types");
+    auto p = new (arena_[a].allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+    p_.push_back(p);
+    kind_.push_back(a);
+    return *p;
+  }
+
+  void reserve(std::size_t n)
+  {
+    p_.reserve(n);
+    kind_.reserve(n);
+  }
+  std::size_t size() const
+  {
+    return p_.size();
+  }
+  bool empty() const
+  {
+    return p_.empty();
+  }
+  Base* operator[](std::size_t i) const
+  {
+    return p_[i];
+  }
+  const_iterator begin() const
+  {
+    return p_.begin();
+  }
+  const_iterator end() const
+  {
+    return p_.end();
+  }
+
+  // the pointers by arena, each in order of allocation (= of address in
+  // each chunk)
+  void group()
+  {
+    if (NArenas == 1)
+      return;
+    std::size_t first[NArenas + 1] = {};
+    for (auto k : kind_)
+      ++first[k + 1];
+    for (int a = 0; a < NArenas; ++a)
+      first[a + 1] += first[a];
+    std::vector<Base*> p(p_.size());
+    for (std::size_t i = 0; i < p_.size(); ++i)
+      p[first[kind_[i]]++] = p_[i];
+    p_.swap(p);
+    std::sort(kind_.begin(), kind_.end());
+  }
+
+  // destroy all the objects, release all the memory
+  void clear()
+  {
+    for (auto p : p_)
+      p->~Base();
+    p_.clear();
+    kind_.clear();
+    for (auto& a : arena_)
+      a.release();
+  }
+
+private:
+  std::vector<Base*> p_;
+  std::vector<unsigned char> kind_;
+  std::array<Monotonic, NArenas> arena_;
+};
+
+} // namespace arena
+
+#endif
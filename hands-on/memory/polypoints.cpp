@@ -1,3 +1,7 @@
+// c++ -O2 -std=c++17 -Wall polypoints.cpp
+//  -DARENA                the objects in one arena (polyArena.h)
+//  -DARENA -DGROUPED      one arena per type, loop grouped by type
+//
 #include<random>
 #include<cstdint>
 #include<algorithm>
@@ -6,6 +10,7 @@
 #include<cassert>
 #include<list>
 #include<memory>
+#include "polyArena.h"
 
 
 
@@ -52,7 +57,13 @@ std::uniform_real_distribution<Float> ugen(Float(-1),Float(1));
 std::uniform_int_distribution<int> igen(1,10);
 
 
+#ifndef ARENA
 using Container = std::list<std::unique_ptr<BasePoint>>;
+#elif defined(GROUPED)
+using Container = arena::PolyVector<BasePoint,PointA,PointB>;
+#else
+using Container = arena::PolyVector<BasePoint>;
+#endif
 
 Container generate() {
 
@@ -61,14 +72,23 @@ Container generate() {
   int ntot = aGen(reng);
   for (int i=0; i<ntot; ++i) {
     auto w = igen(reng);
+#ifndef ARENA
     std::unique_ptr<BasePoint> p(w>5 ? (BasePoint*)(new PointA()) : (BasePoint*)(new PointB())); 
+#else
+    BasePoint * p = w>5 ? (BasePoint*)(&cont.emplace_back<PointA>()) : (BasePoint*)(&cont.emplace_back<PointB>());
+#endif
     p->set_x(ugen(reng));
     p->y =  ugen(reng);
     p->z =  ugen(reng);
     auto r = igen(reng);
     p->ok = r<7;
+#ifndef ARENA
     cont.insert(cont.end(),std::move(p));
+#endif
   }
+#ifdef GROUPED
+  cont.group();
+#endif
   
   return cont;
 
@@ -76,6 +96,16 @@ Container generate() {
 
 
 
+// move assignment into a full container, the source left empty and usable
+void checkMove() {
+  Container a = generate(), b = generate();
+  auto n = a.size();
+  b = std::move(a);
+  assert(b.size()==n && a.empty());
+  a = generate();
+  assert(!a.empty());
+}
+
 int main() {
 
   auto start = std::chrono::high_resolution_clock::now();
@@ -84,6 +114,7 @@ int main() {
 
 
   auto points = generate();
+  checkMove();
   
 
   for (int k=0; k<2000; ++k) {
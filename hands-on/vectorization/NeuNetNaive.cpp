@@ -102,12 +102,7 @@ struct NeuNet
   }
 };
 
-#include <x86intrin.h>
-unsigned int taux = 0;
-inline unsigned long long rdtscp()
-{
-  return __rdtscp(&taux);
-}
+#include "../architecture/cycleTimer.h"
 
 template<typename Data>
 struct Reader
@@ -159,7 +154,7 @@ void go()
       w = wgen(eng);
 
   // timers
-  long long tt = 0, tc = 0;
+  benchmark::CycleTimer tt, tc;
 
   using Data                     = std::array<float, NX>; // one row
   constexpr unsigned int bufSize = 1024;
@@ -169,7 +164,7 @@ void go()
   // train
   Reader<Data> reader1(Nentries / 4);
   while (reader1(buffer) >= 0) {
-    tt -= rdtscp();
+    tt.start();
     int ll = 4;
     for (auto& b : buffer) {
       float t = 0.f;
@@ -181,7 +176,7 @@ void go()
         ++ll;
       net.train(b, t, 0.02f);
     }
-    tt += rdtscp();
+    tt.stop();
   }
 
   double count = 0;
@@ -192,18 +187,21 @@ void go()
   Reader<Data> reader2(Nentries);
   // classify
   while (reader2(buffer) >= 0) {
-    tc -= rdtscp();
+    tc.start();
     for (auto& b : buffer) {
       if (net(b) > cut)
         ++pass;
       ++count;
     }
-    tc += rdtscp();
+    tc.stop();
   }
 
   std::cout << "\nInput Size " << NX << " layer size " << MNodes << std::endl;
-  std::cout << "total time training " << double(tt) * 1.e-9 << std::endl;
-  std::cout << "total time classification " << double(tc) * 1.e-9 << std::endl;
+  std::cout << "total time training " << tt.ns() * 1.e-9 << " s ("
+            << tt.cycles() / (Nentries / 4) << " cycles per entry)"
+            << std::endl;
+  std::cout << "total time classification " << tc.ns() * 1.e-9 << " s ("
+            << tc.cycles() / Nentries << " cycles per entry)" << std::endl;
   std::cout << "final result " << pass / count << std::endl;
 }
 
@@ -3,17 +3,18 @@
 #include <limits>
 #include <random>
 #include <vector>
-// c++ -Ofast -fopenmp -mavx2 -mfma NeuNetNaive.cpp  -fopt-info-vec
+// c++ -Ofast -fopenmp -Wno-psabi NeuNetSOA.cpp  -fopt-info-vec
+// (no -march: the SSE4, AVX2 or AVX-512 version is chosen at run time,
+//  BENCH_ISA=sse4|avx2|avx512 to force one, see isaDispatch.h)
 // -ftree-loop-if-convert-stores
 // --param max-completely-peel-times=1
 
 #include <omp.h>
 #include <cstdlib>
 
+#include "../architecture/isaDispatch.h"
 #include "approx_vexp.h"
 
-constexpr nativeVector::FVect vuno = nativeVector::vzero + 1.f;
-
 template<typename T>
 T sig(T x)
 {
@@ -32,7 +33,7 @@ struct Neuron
   {
     using namespace nativeVector;
     input = x;
-    T res = vzero + w[N];
+    T res = T{} + w[N];
     for (int i = 0; i < N; ++i)
       res += w[i] * x[i];
     return result = sig(res);
@@ -42,7 +43,7 @@ struct Neuron
   {
     using namespace nativeVector;
     input = x;
-    T res = vzero + w[N];
+    T res = T{} + w[N];
     for (int i = 0; i < N; ++i)
       res += w[i] * x[i];
     return res;
@@ -54,11 +55,11 @@ struct Neuron
     T corr = learingRate * result * (1.f - result) * error;
     for (int i = 0; i < N; ++i) {
       T tmp = corr * input[i];
-      for (auto j = 0U; j < VSIZE; ++j)
-        w[i] += tmp[j] / float(VSIZE);
+      for (auto j = 0U; j < vsize<T>; ++j)
+        w[i] += tmp[j] / float(vsize<T>);
     }
-    for (auto j = 0U; j < VSIZE; ++j)
-      w[N] += corr[j] / float(VSIZE);
+    for (auto j = 0U; j < vsize<T>; ++j)
+      w[N] += corr[j] / float(vsize<T>);
   }
   mutable std::array<T, N> input;
   mutable T result;
@@ -106,7 +107,7 @@ struct NeuNet
     for (int i = 0; i < M; ++i)
       middle.neurons[i].error = output.w[i] * output.error;
     for (int i = 0; i < M; ++i)
-      input.neurons[i].error = vzero;
+      input.neurons[i].error = T{};
     for (int j = 0; j < M; ++j)
       for (int i = 0; i < M; ++i)
         input.neurons[j].error +=
@@ -117,12 +118,7 @@ struct NeuNet
   }
 };
 
-#include <x86intrin.h>
-unsigned int taux = 0;
-inline unsigned long long rdtscp()
-{
-  return __rdtscp(&taux);
-}
+#include "../architecture/cycleTimer.h"
 
 #include <ext/random>
 
@@ -154,7 +150,7 @@ struct Reader
 };
 
 #include <iostream>
-template<int NX, int MNodes>
+template<typename V, int NX, int MNodes>
 void go()
 {
   using namespace nativeVector;
@@ -171,7 +167,7 @@ void go()
   // FVect{wgen(eng),wgen(eng),wgen(eng),wgen(eng),
   // wgen(eng),wgen(eng),wgen(eng),wgen(eng)}; };
 
-  NeuNet<FVect, NX, MNodes> net;
+  NeuNet<V, NX, MNodes> net;
 
   for (auto& w : net.output.w)
     w = wgen(eng);
@@ -182,48 +178,49 @@ void go()
     for (auto& w : n.w)
       w = wgen(eng);
 
-  FVect res    = vzero;
+  V res        = V{};
+  V const one  = V{} + 1.f;
   double count = 0;
 
-  long long tt = 0, tc = 0;
-  constexpr int vsize            = VSIZE;
+  benchmark::CycleTimer tt, tc;
+  constexpr int vsize            = nativeVector::vsize<V>;
   constexpr unsigned int bufSize = 1024;
   // "Struct of Arrays"
   using Data = std::array<float*, NX>; // NX columns
   Data buffer;
   for (auto& b : buffer)
-    posix_memalign((void**)(&b), sizeof(FVect), sizeof(float) * bufSize);
-  // aligned_alloc(sizeof(FVect), sizeof(float)*bufSize);  // yes, leaks...
+    posix_memalign((void**)(&b), sizeof(V), sizeof(float) * bufSize);
+  // aligned_alloc(sizeof(V), sizeof(float)*bufSize);  // yes, leaks...
 
   // train
   Reader<Data> reader1(Nentries / 4);
   while (reader1(buffer, bufSize) >= 0) {
-    tt -= rdtscp();
+    tt.start();
     for (auto j = 0U; j < bufSize; j += vsize) {
-      std::array<FVect, NX> b;
-      FVect t = vzero;
-      t[0]    = 1.f;
-      if (vsize > 4)
-        t[4] = 1.f;
+      std::array<V, NX> b;
+      V t = V{};
+      // one out of 4 is signal
+      for (int i = 0; i < vsize; i += 4)
+        t[i] = 1.f;
       for (int k = 0; k < NX; ++k)
-        b[k] = ((FVect const&)(buffer[k][j]));
+        b[k] = ((V const&)(buffer[k][j]));
       net.train(b, t, 0.02f);
     }
-    tt += rdtscp();
+    tt.stop();
   }
 
   // classifiy
   Reader<Data> reader2(Nentries);
   while (reader2(buffer, bufSize) >= 0) {
-    tc -= rdtscp();
+    tc.start();
     for (auto j = 0U; j < bufSize; j += vsize) {
-      std::array<FVect, NX> b;
+      std::array<V, NX> b;
       for (int k = 0; k < NX; ++k)
-        b[k] = ((FVect const&)(buffer[k][j]));
-      res += (net(b) > 0.5f) ? vuno : vzero;
+        b[k] = ((V const&)(buffer[k][j]));
+      res += (net(b) > 0.5f) ? one : V{};
       count += vsize;
     }
-    tc += rdtscp();
+    tc.stop();
   }
 
   float rr = 0;
@@ -231,15 +228,36 @@ void go()
     rr += res[i];
   std::cout << "\nInput Size " << NX << " layer size " << MNodes << std::endl;
   std::cout << "Vector size " << vsize << std::endl;
-  std::cout << "total time training " << double(tt) * 1.e-9 << std::endl;
-  std::cout << "total time classification " << double(tc) * 1.e-9 << std::endl;
+  std::cout << "total time training " << tt.ns() * 1.e-9 << " s ("
+            << tt.cycles() / (Nentries / 4) << " cycles per entry)"
+            << std::endl;
+  std::cout << "total time classification " << tc.ns() * 1.e-9 << " s ("
+            << tc.cycles() / Nentries << " cycles per entry)" << std::endl;
   std::cout << "final result " << rr / count << std::endl;
 }
 
+// the whole of go() is compiled for each ISA
+ISA_SSE4 void goSSE4()
+{
+  go<nativeVector::float32x4_t, 10, 14>();
+  go<nativeVector::float32x4_t, 10, 7>();
+}
+ISA_AVX2 void goAVX2()
+{
+  go<nativeVector::float32x8_t, 10, 14>();
+  go<nativeVector::float32x8_t, 10, 7>();
+}
+ISA_AVX512 void goAVX512()
+{
+  go<nativeVector::float32x16_t, 10, 14>();
+  go<nativeVector::float32x16_t, 10, 7>();
+}
+
 int main()
 {
-  go<10, 14>();
-  go<10, 7>();
+  std::cout << "running the " << isa::name(isa::selected()) << " version"
+            << std::endl;
+  isa::select(goSSE4, goAVX2, goAVX512)();
 
   return 0;
 }
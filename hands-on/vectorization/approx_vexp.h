@@ -235,12 +235,12 @@ inline Float __attribute__((always_inline)) unsafe_expf_impl(Float x)
   // constexpr Float rnd_cst = Float(0xc.p20);
   constexpr float inv_log2f = float(0x1.715476p0);
 
-  // This is doing round(x*inv_log2f) to the nearest integer
-  // Float z = std::floor((x*inv_log2f) +0.5f); Int e = z;
+  // This is doing round(x*inv_log2f) to the nearest integer, so that
+  // |y| <= log(2)/2: convert truncates (for all ISAs), hence |x| + 0.5
   using nativeVector::abs;
   using std::abs;
   // exponent
-  Int e   = toIF<Float>::convert(abs(x * inv_log2f) - 0.5f);
+  Int e   = toIF<Float>::convert(abs(x * inv_log2f) + 0.5f);
   e       = (x > 0) ? e : -e;
   Float z = toIF<Float>::convert(e);
 
@@ -250,11 +250,14 @@ inline Float __attribute__((always_inline)) unsafe_expf_impl(Float x)
   // but then we could have 2^e = below being infinity when it shouldn't
   // (when e=128 but p<1)
   // so we avoid this case by reducing e and evaluating a polynomial for 2*exp
-  e -= 1;
+  // For x < 0 e can be -126 (x close to log(2^-126)), and e - 1 would not be
+  // a normal exponent: there p is halved instead (exact)
+  e = (x > 0) ? e - 1 : e;
 
   // NaN inputs will propagate to the output as expected
 
   Float p = approx_expf_P<Float, DEGREE>::impl(y);
+  p       = (x > 0) ? p : 0.5f * p;
 
   // cout << "x=" << x << "  e=" << e << "  y=" << y << "  p=" << p <<"\n";
   UInt biased_exponent = UInt(e + 127);
@@ -275,10 +278,11 @@ template<typename Float, int DEGREE, bool FMA>
 inline Float __attribute__((always_inline)) approx_expf(Float x)
 {
   using namespace nativeVector;
-  constexpr Float zero{0.f};
-  constexpr Float inf_threshold = zero + float(0x5.8b90cp4);
+  // not constexpr: gcc does not fold vector arithmetic in constant expressions
+  Float const zero{0.f};
+  Float const inf_threshold = zero + float(0x5.8b90cp4);
   // log of the smallest normal
-  constexpr Float zero_threshold_ftz =
+  Float const zero_threshold_ftz =
       zero - float(0x5.75628p4); // sollya: single(log(1b-126));
   // flush to zero on the output
   // manage infty output:
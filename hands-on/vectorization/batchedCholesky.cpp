@@ -0,0 +1,177 @@
+//
+//  inversion of millions of small symmetric positive definite matrices:
+//  one at a time (scalar, 1/std::sqrt) against one per SIMD lane
+//  (smallMatrix::invertSymmetric, rsqrt estimate + Newton)
+//
+//  c++ -O2 -march=native batchedCholesky.cpp
+//  c++ -O2 batchedCholesky.cpp             (SSE, estimate from _mm_rsqrt_ps)
+//  c++ -O2 -march=native -DNEWTON_STEPS=0 ...  (the bare estimate)
+//
+//  the accuracy is measured against the inversion in double precision, as
+//  max |A A^-1 - 1| and as the max relative error of the elements
+//
+#include "../architecture/benchRunner.h"
+#include "smallMatrixSoA.h"
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#ifndef NEWTON_STEPS
+#define NEWTON_STEPS 1
+#endif
+
+constexpr std::size_t NMat = 1 << 16;
+
+template<typename T, std::size_t N>
+using Mat = std::array<std::array<T, N>, N>;
+
+// the textbook Cholesky inversion, as invertSymmetric in smallMatrixSoA.h
+template<typename T, std::size_t N>
+void invert(Mat<float, N> const& a, Mat<T, N>& r)
+{
+  Mat<T, N> l, m;
+  T d[N];
+  for (std::size_t j = 0; j < N; ++j) {
+    T s = a[j][j];
+    for (std::size_t k = 0; k < j; ++k)
+      s -= l[j][k] * l[j][k];
+    d[j]    = T(1) / std::sqrt(s);
+    l[j][j] = s * d[j];
+    for (std::size_t i = j + 1; i < N; ++i) {
+      T x = a[i][j];
+      for (std::size_t k = 0; k < j; ++k)
+        x -= l[i][k] * l[j][k];
+      l[i][j] = x * d[j];
+    }
+  }
+  for (std::size_t j = 0; j < N; ++j) {
+    m[j][j] = d[j];
+    for (std::size_t i = j + 1; i < N; ++i) {
+      T x = l[i][j] * m[j][j];
+      for (std::size_t k = j + 1; k < i; ++k)
+        x += l[i][k] * m[k][j];
+      m[i][j] = -x * d[i];
+    }
+  }
+  for (std::size_t i = 0; i < N; ++i)
+    for (std::size_t j = 0; j <= i; ++j) {
+      T x = m[i][i] * m[i][j];
+      for (std::size_t k = i + 1; k < N; ++k)
+        x += m[k][i] * m[k][j];
+      r[i][j] = r[j][i] = x;
+    }
+}
+
+// random covariances: B B^T + eps, in both layouts
+template<int N>
+struct Data
+{
+  std::vector<Mat<float, N>> a, r;
+  smallMatrix::MatrixBatch<N, N> va, vr;
+
+  Data()
+      : a(NMat)
+      , r(NMat)
+      , va(NMat)
+      , vr(NMat)
+  {
+    std::mt19937 eng;
+    std::uniform_real_distribution<float> rgen(-1., 1.);
+    for (std::size_t k = 0; k < NMat; ++k) {
+      float b[N][N];
+      for (auto& row : b)
+        for (auto& x : row)
+          x = rgen(eng);
+      for (int i = 0; i < N; ++i)
+        for (int j = 0; j <= i; ++j) {
+          float x = i == j ? 0.1f : 0.f;
+          for (int p = 0; p < N; ++p)
+            x += b[i][p] * b[j][p];
+          a[k][i][j] = a[k][j][i] = va(k, i, j) = va(k, j, i) = x;
+        }
+    }
+  }
+};
+
+template<int N>
+void inversionScalar(benchmark::State& st)
+{
+  Data<N> d;
+  st.setItems(NMat);
+  st.setBytes(2. * sizeof(float) * N * N * NMat);
+  while (st.next()) {
+    for (std::size_t k = 0; k < NMat; ++k)
+      invert(d.a[k], d.r[k]);
+    benchmark::keep(d.r);
+  }
+}
+
+template<int N>
+void inversionSoA(benchmark::State& st)
+{
+  Data<N> d;
+  st.setItems(NMat);
+  st.setBytes(2. * sizeof(float) * N * N * NMat);
+  while (st.next()) {
+    smallMatrix::invertSymmetric<NEWTON_STEPS>(d.va, d.vr);
+    benchmark::keep(d.vr);
+  }
+
+  // against the inversion in double
+  double maxRel = 0, maxRes = 0;
+  for (std::size_t k = 0; k < NMat; ++k) {
+    Mat<double, N> ref;
+    invert(d.a[k], ref);
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < N; ++j) {
+        maxRel = std::max(maxRel,
+                          std::abs(d.vr(k, i, j) - ref[i][j])
+                              / std::sqrt(ref[i][i] * ref[j][j]));
+        double x = i == j ? -1. : 0.;
+        for (int p = 0; p < N; ++p)
+          x += double(d.a[k][i][p]) * d.vr(k, p, j);
+        maxRes = std::max(maxRes, std::abs(x));
+      }
+  }
+  std::cout << N << 'x' << N << " inversion: max |A A^-1 - 1| " << maxRes
+            << ", max error relative to sqrt(c_ii c_jj) " << maxRel
+            << std::endl;
+}
+
+// max relative error of the rsqrt estimate and of its refinement
+void rsqrtAccuracy()
+{
+  using nativeVector::FVect;
+  constexpr int W = nativeVector::VSIZE;
+  double maxEst = 0, maxRef = 0;
+  for (float x = 1.e-6f; x < 1.e6f; x *= 1.0001f) {
+    FVect v = nativeVector::vzero + x;
+    for (int i = 0; i < W; ++i)
+      v[i] *= 1.f + 0.0001f * i / W;
+    auto e = smallMatrix::rsqrtEstimate(v);
+    auto r = smallMatrix::rsqrt<NEWTON_STEPS>(v);
+    for (int i = 0; i < W; ++i) {
+      double exact = 1. / std::sqrt(double(v[i]));
+      maxEst       = std::max(maxEst, std::abs(e[i] - exact) / exact);
+      maxRef       = std::max(maxRef, std::abs(r[i] - exact) / exact);
+    }
+  }
+  std::cout << "rsqrt max relative error: estimate " << maxEst << ", after "
+            << NEWTON_STEPS << " Newton step(s) " << maxRef
+            << " (float epsilon " << std::numeric_limits<float>::epsilon()
+            << ")" << std::endl;
+}
+
+BENCHMARK(inversionScalar<3>);
+BENCHMARK(inversionSoA<3>);
+BENCHMARK(inversionScalar<5>);
+BENCHMARK(inversionSoA<5>);
+
+int main(int argc, char** argv)
+{
+  rsqrtAccuracy();
+  return benchmark::main(argc, argv);
+}
@@ -0,0 +1,201 @@
+//
+//  millions of small matrix products: one matrix at a time (AoS, scalar
+//  loops) against one matrix per SIMD lane (smallMatrixSoA.h)
+//
+//  c++ -O2 -march=native batchedMatrix.cpp
+//  ./a.out --filter=similarity
+//
+//  compare ns/item (one matrix) for 3x3, 5x5 and 6x6, and with -O3 or
+//  -funroll-loops: does the compiler vectorize the AoS version?
+//
+#include "../architecture/benchRunner.h"
+#include "smallMatrixSoA.h"
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+constexpr std::size_t NMat = 1 << 16;
+
+template<std::size_t R, std::size_t C>
+using Mat = std::array<std::array<float, C>, R>;
+
+template<std::size_t R, std::size_t K, std::size_t C>
+void multiply(Mat<R, K> const& a, Mat<K, C> const& b, Mat<R, C>& c)
+{
+  for (std::size_t i = 0; i < R; ++i)
+    for (std::size_t j = 0; j < C; ++j) {
+      float s = 0;
+      for (std::size_t k = 0; k < K; ++k)
+        s += a[i][k] * b[k][j];
+      c[i][j] = s;
+    }
+}
+
+// a s a^T, only the lower triangle computed (as in smallMatrixSoA.h)
+template<std::size_t R, std::size_t K>
+void similarity(Mat<R, K> const& a, Mat<K, K> const& s, Mat<R, R>& r)
+{
+  Mat<R, K> as;
+  multiply(a, s, as);
+  for (std::size_t i = 0; i < R; ++i)
+    for (std::size_t j = 0; j <= i; ++j) {
+      float x = 0;
+      for (std::size_t k = 0; k < K; ++k)
+        x += as[i][k] * a[j][k];
+      r[i][j] = r[j][i] = x;
+    }
+}
+
+template<std::size_t R, std::size_t C>
+void add(Mat<R, C> const& a, Mat<R, C> const& b, Mat<R, C>& c)
+{
+  for (std::size_t i = 0; i < R; ++i)
+    for (std::size_t j = 0; j < C; ++j)
+      c[i][j] = a[i][j] + b[i][j];
+}
+
+// the same random matrices in both layouts, s symmetric positive definite
+template<int N>
+struct Data
+{
+  std::vector<Mat<N, N>> a, b, s, r;
+  smallMatrix::MatrixBatch<N, N> va, vb, vs, vr;
+
+  Data()
+      : a(NMat)
+      , b(NMat)
+      , s(NMat)
+      , r(NMat)
+      , va(NMat)
+      , vb(NMat)
+      , vs(NMat)
+      , vr(NMat)
+  {
+    std::mt19937 eng;
+    std::uniform_real_distribution<float> rgen(-1., 1.);
+    for (std::size_t k = 0; k < NMat; ++k)
+      for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j) {
+          a[k][i][j] = va(k, i, j) = rgen(eng);
+          b[k][i][j] = vb(k, i, j) = rgen(eng);
+          if (j <= i)
+            s[k][i][j] = s[k][j][i] = vs(k, i, j) = vs(k, j, i) =
+                (i == j ? N : 0) + 0.5f * rgen(eng);
+        }
+  }
+
+  // largest difference between the two layouts of the result
+  float diff() const
+  {
+    float d = 0;
+    for (std::size_t k = 0; k < NMat; ++k)
+      for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j)
+          d = std::max(d, std::abs(r[k][i][j] - vr(k, i, j)));
+    return d;
+  }
+};
+
+template<int N>
+void setup(benchmark::State& st, double flops, double inputs)
+{
+  st.setItems(NMat);
+  st.setFlops(flops * NMat);
+  st.setBytes(sizeof(float) * (inputs + 1) * N * N * NMat);
+}
+
+template<int N>
+void multiplyAoS(benchmark::State& st)
+{
+  Data<N> d;
+  setup<N>(st, 2. * N * N * N, 2);
+  while (st.next()) {
+    for (std::size_t k = 0; k < NMat; ++k)
+      multiply(d.a[k], d.b[k], d.r[k]);
+    benchmark::keep(d.r);
+  }
+}
+
+template<int N>
+void multiplySoA(benchmark::State& st)
+{
+  Data<N> d;
+  setup<N>(st, 2. * N * N * N, 2);
+  while (st.next()) {
+    smallMatrix::multiply(d.va, d.vb, d.vr);
+    benchmark::keep(d.vr);
+  }
+  for (std::size_t k = 0; k < NMat; ++k)
+    multiply(d.a[k], d.b[k], d.r[k]);
+  std::cout << N << 'x' << N << " multiply, max difference " << d.diff()
+            << std::endl;
+}
+
+template<int N>
+void similarityAoS(benchmark::State& st)
+{
+  Data<N> d;
+  setup<N>(st, 2. * N * N * N + N * (N + 1) * N, 2);
+  while (st.next()) {
+    for (std::size_t k = 0; k < NMat; ++k)
+      similarity(d.a[k], d.s[k], d.r[k]);
+    benchmark::keep(d.r);
+  }
+}
+
+template<int N>
+void similaritySoA(benchmark::State& st)
+{
+  Data<N> d;
+  setup<N>(st, 2. * N * N * N + N * (N + 1) * N, 2);
+  while (st.next()) {
+    smallMatrix::similarity(d.va, d.vs, d.vr);
+    benchmark::keep(d.vr);
+  }
+  for (std::size_t k = 0; k < NMat; ++k)
+    similarity(d.a[k], d.s[k], d.r[k]);
+  std::cout << N << 'x' << N << " similarity, max difference " << d.diff()
+            << std::endl;
+}
+
+template<int N>
+void addAoS(benchmark::State& st)
+{
+  Data<N> d;
+  setup<N>(st, N * N, 2);
+  while (st.next()) {
+    for (std::size_t k = 0; k < NMat; ++k)
+      add(d.a[k], d.b[k], d.r[k]);
+    benchmark::keep(d.r);
+  }
+}
+
+template<int N>
+void addSoA(benchmark::State& st)
+{
+  Data<N> d;
+  setup<N>(st, N * N, 2);
+  while (st.next()) {
+    smallMatrix::add(d.va, d.vb, d.vr);
+    benchmark::keep(d.vr);
+  }
+}
+
+BENCHMARK(multiplyAoS<3>);
+BENCHMARK(multiplySoA<3>);
+BENCHMARK(multiplyAoS<5>);
+BENCHMARK(multiplySoA<5>);
+BENCHMARK(multiplyAoS<6>);
+BENCHMARK(multiplySoA<6>);
+BENCHMARK(similarityAoS<3>);
+BENCHMARK(similaritySoA<3>);
+BENCHMARK(similarityAoS<5>);
+BENCHMARK(similaritySoA<5>);
+BENCHMARK(similarityAoS<6>);
+BENCHMARK(similaritySoA<6>);
+BENCHMARK(addAoS<5>);
+BENCHMARK(addSoA<5>);
+
+BENCHMARK_MAIN()
@@ -1,7 +1,6 @@
-#include "../architecture/benchmark.h"
+#include "../architecture/benchRunner.h"
 #include <array>
 #include <cassert>
-#include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iomanip>
@@ -20,7 +19,7 @@ void put(std::ostream& co, T x)
     co << out[i];
 }
 
-int main()
+void binningKernel(benchmark::State& st)
 {
   constexpr int N = 1 << 14;
   std::cout << "working with batch of " << N << " particles" << std::endl;
@@ -32,11 +31,14 @@ int main()
 
   P p;
 
-  auto start = std::chrono::high_resolution_clock::now();
-  auto delta = start - start;
-
-  // outer loop just to make timing "macroscopical"
-  for (int j = 0; j < 1000; ++j) {
+  // each sample bins a new batch: its generation is not timed
+  st.setItems(N);
+  // std::sin/cos are calls to libm: no flop count (no GFLOP/s, not on the
+  // roofline), only the bytes, to compare with the simpleSinCos versions
+  // read phi and r, update a bin of the histogram
+  st.setBytes(16. * N, 8. * N + sizeof(int) * (100 + 1) * (100 + 1));
+  while (st.next()) {
+    st.pause();
     for (int i = 0; i < N; ++i) {
       p.phi[i] = -M_PI + 2. * M_PI * rgen(eng);
       p.r[i]   = rgen(eng);
@@ -50,7 +52,7 @@ int main()
 
     Hist h;
 
-    delta -= (std::chrono::high_resolution_clock::now() - start);
+    st.resume();
     benchmark::touch(p);
     // the real loop
     for (int i = 0; i < N; ++i) {
@@ -63,13 +65,10 @@ int main()
       ++h.bin[xbin][ybin];
     }
     benchmark::keep(h);
-    delta += (std::chrono::high_resolution_clock::now() - start);
     //    std::cout << '.';
   }
-  std::cout
-      << " Computation took "
-      << std::chrono::duration_cast<std::chrono::milliseconds>(delta).count()
-      << " ms" << std::endl;
-
-  return 0;
 }
+
+BENCHMARK(binningKernel);
+
+BENCHMARK_MAIN()
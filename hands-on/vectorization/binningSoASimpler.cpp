@@ -1,8 +1,7 @@
 #include "simpleSinCos.h"
-#include "../architecture/benchmark.h"
+#include "../architecture/benchRunner.h"
 #include <array>
 #include <cassert>
-#include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iomanip>
@@ -21,7 +20,7 @@ void put(std::ostream& co, T x)
     co << out[i];
 }
 
-int main()
+void binningKernel(benchmark::State& st)
 {
   constexpr int N = 1 << 14;
   std::cout << "working with batch of " << N << " particles" << std::endl;
@@ -33,11 +32,15 @@ int main()
 
   P p;
 
-  auto start = std::chrono::high_resolution_clock::now();
-  auto delta = start - start;
-
-  // outer loop just to make timing "macroscopical"
-  for (int j = 0; j < 1000; ++j) {
+  // each sample bins a new batch: its generation is not timed
+  st.setItems(N);
+  // 35 flops: simpleCos and simpleSin are the same simpleSinCos (29), computed
+  // once after inlining (64 as written), r * c, r * s and (x + 1) * w for
+  // each bin. Read phi and r, update a bin of the histogram
+  st.setFlops(35. * N);
+  st.setBytes(16. * N, 8. * N + sizeof(int) * (100 + 1) * (100 + 1));
+  while (st.next()) {
+    st.pause();
     for (int i = 0; i < N; ++i) {
       p.phi[i] = -M_PI + 2. * M_PI * rgen(eng);
       p.r[i]   = rgen(eng);
@@ -51,7 +54,7 @@ int main()
 
     Hist h;
 
-    delta -= (std::chrono::high_resolution_clock::now() - start);
+    st.resume();
     benchmark::touch(p);
     // the real loop
     for (int i = 0; i < N; ++i) {
@@ -64,13 +67,10 @@ int main()
       ++h.bin[xbin][ybin];
     }
     benchmark::keep(h);
-    delta += (std::chrono::high_resolution_clock::now() - start);
     //    std::cout << '.';
   }
-  std::cout
-      << " Computation took "
-      << std::chrono::duration_cast<std::chrono::milliseconds>(delta).count()
-      << " ms" << std::endl;
-
-  return 0;
 }
+
+BENCHMARK(binningKernel);
+
+BENCHMARK_MAIN()
@@ -1,8 +1,7 @@
 #include "simpleSinCos.h"
-#include "../architecture/benchmark.h"
+#include "../architecture/benchRunner.h"
 #include <array>
 #include <cassert>
-#include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iomanip>
@@ -21,7 +20,7 @@ void put(std::ostream& co, T x)
     co << out[i];
 }
 
-int main()
+void binningKernel(benchmark::State& st)
 {
   constexpr int N = 1 << 14;
   std::cout << "working with batch of " << N << " particles" << std::endl;
@@ -40,11 +39,14 @@ int main()
 
   Points points;
 
-  auto start = std::chrono::high_resolution_clock::now();
-  auto delta = start - start;
-
-  // outer loop just to make timing "macroscopical"
-  for (int j = 0; j < 1000; ++j) {
+  // each sample bins a new batch: its generation is not timed
+  st.setItems(N);
+  // 35 flops: simpleSinCos (29), r * c, r * s and (x + 1) * w for each bin
+  // read phi and r, update a bin of the histogram
+  st.setFlops(35. * N);
+  st.setBytes(16. * N, 8. * N + sizeof(int) * (100 + 1) * (100 + 1));
+  while (st.next()) {
+    st.pause();
     for (auto& p : points.p) {
       p.phi = -M_PI + 2. * M_PI * rgen(eng);
       p.r   = rgen(eng);
@@ -58,7 +60,7 @@ int main()
 
     Hist h;
 
-    delta -= (std::chrono::high_resolution_clock::now() - start);
+    st.resume();
     benchmark::touch(points);
     // the real loop
     int stride = 16;
@@ -80,13 +82,10 @@ int main()
         ++h.bin[xbin[k]][ybin[k]];
     }
     benchmark::keep(h);
-    delta += (std::chrono::high_resolution_clock::now() - start);
     //    std::cout << '.';
   }
-  std::cout
-      << " Computation took "
-      << std::chrono::duration_cast<std::chrono::milliseconds>(delta).count()
-      << " ms" << std::endl;
-
-  return 0;
 }
+
+BENCHMARK(binningKernel);
+
+BENCHMARK_MAIN()
@@ -81,19 +81,16 @@ struct ConvertVector
   using F                 = decltype(VType<VF>::elem(VF()));
   static constexpr int N  = NV / sizeof(F);
   typedef typename IntType<F>::type __attribute__((vector_size(NV))) itype;
+  // float to int truncates (as in C++) here and in all the
+  // specializations, so that the result does not depend on the ISA the
+  // caller is compiled for (see isaDispatch.h)
   static VF impl(itype i)
   {
-    VF f;
-    for (int j = 0; j < N; ++j)
-      f[j] = i[j];
-    return f;
+    return __builtin_convertvector(i, VF);
   }
   static itype impl(VF f)
   {
-    itype i;
-    for (int j = 0; j < N; ++j)
-      i[j] = f[j];
-    return i;
+    return __builtin_convertvector(f, itype);
   }
 };
 
@@ -131,7 +128,7 @@ struct ConvertVector<float32x8_t>
   }
   static itype impl(VF f)
   {
-    return itype(_mm256_cvtps_epi32(__m256(f)));
+    return itype(_mm256_cvttps_epi32(__m256(f)));
   }
 };
 #endif
@@ -240,6 +237,10 @@ V1 abs(V1 a)
   return (a > 0) ? a : -a;
 }
 
+// number of floats in V, for code templated on the vector type
+template<typename V>
+constexpr unsigned int vsize = sizeof(V) / sizeof(float);
+
 #ifdef SCALAR
 constexpr unsigned int VSIZE = 1;
 using FVect                  = float;
@@ -42,29 +42,31 @@ float pi<float32x4_t>(int num_steps)
   return step * (sum[0] + sum[1] + sum[2] + sum[3]);
 }
 
-#include <chrono>
-#include <iostream>
+#include "../architecture/benchRunner.h"
+
+constexpr int num_steps = 32 * 1024 * 1024;
 
 template<typename T>
-void go(int num_steps)
+void piKernel(benchmark::State& st)
 {
-  auto start      = std::chrono::high_resolution_clock::now();
-  auto res        = pi<T>(num_steps);
-  auto total_time = std::chrono::high_resolution_clock::now() - start;
-  std::cout << "pi = " << res << " in " << total_time.count() << std::endl;
+  float res = 0;
+  st.setItems(num_steps);
+  // no memory traffic at all
+  st.setFlops(6. * num_steps);
+  while (st.next()) {
+    res = pi<T>(num_steps);
+    benchmark::keep(res);
+  }
+  std::cout << "pi = " << res << std::endl;
 }
 
-int main()
-{
-  auto total_time = std::chrono::high_resolution_clock::duration{};
+BENCHMARK(piKernel<float>);
+BENCHMARK(piKernel<double>);
+BENCHMARK(piKernel<float32x4_t>);
 
-  constexpr int num_steps = 32 * 1024 * 1024;
+int main(int argc, char** argv)
+{
   std::cout << "nsteps, step " << num_steps << ' ' << 1. / num_steps
             << std::endl;
-
-  go<float>(num_steps);
-  go<double>(num_steps);
-  go<float32x4_t>(num_steps);
-
-  return 0;
+  return benchmark::main(argc, argv);
 }
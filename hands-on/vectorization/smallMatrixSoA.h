@@ -0,0 +1,231 @@
+#ifndef SMALL_MATRIX_SOA_H
+#define SMALL_MATRIX_SOA_H
+//
+//  batches of small fixed size matrices (the 3x3 ... 6x6 covariances of a
+//  track fit) stored "SoA" across the batch: a block holds VSIZE matrices,
+//  element (i,j) of all of them in one native vector, so that each SIMD
+//  lane works on its own matrix and the code is the textbook scalar one
+//
+//    smallMatrix::MatrixBatch<5, 5> f(n), cov(n), res(n);
+//    f(k, i, j) = ...;                        // element (i,j) of matrix k
+//    smallMatrix::similarity(f, cov, res);    // res = f cov f^T, for all k
+//
+//  one matrix of 5x5 floats is 100 bytes: AoS, a vector load would mix
+//  elements of the same matrix and the loops are too short to vectorize
+//
+//  invertSymmetric() inverts symmetric positive definite matrices through
+//  their Cholesky decomposition, A = L L^T, A^-1 = L^-T L^-1: the only
+//  non-trivial operations are N inverse square roots (rsqrt() below), all
+//  the rest are multiply-adds. No pivoting and no check: a matrix that is
+//  not positive definite gives NaNs (in its lane only)
+//
+
+#include "approx_vrsqrt.h"
+#include "nativeVector.h"
+#include <cstddef>
+#include <vector>
+
+namespace smallMatrix {
+
+// VSIZE matrices of R x C, one per lane
+template<int R, int C, typename V = nativeVector::FVect>
+struct MatV
+{
+  static constexpr int rows = R;
+  static constexpr int cols = C;
+
+  V m[R][C];
+
+  V& operator()(int i, int j)
+  {
+    return m[i][j];
+  }
+  V const& operator()(int i, int j) const
+  {
+    return m[i][j];
+  }
+};
+
+template<int R, int C, typename V>
+MatV<R, C, V> operator+(MatV<R, C, V> const& a, MatV<R, C, V> const& b)
+{
+  MatV<R, C, V> c;
+  for (int i = 0; i < R; ++i)
+    for (int j = 0; j < C; ++j)
+      c(i, j) = a(i, j) + b(i, j);
+  return c;
+}
+
+// a b
+template<int R, int K, int C, typename V>
+MatV<R, C, V> operator*(MatV<R, K, V> const& a, MatV<K, C, V> const& b)
+{
+  MatV<R, C, V> c;
+  for (int i = 0; i < R; ++i)
+    for (int j = 0; j < C; ++j) {
+      V s = a(i, 0) * b(0, j);
+      for (int k = 1; k < K; ++k)
+        s += a(i, k) * b(k, j);
+      c(i, j) = s;
+    }
+  return c;
+}
+
+// a s a^T, s symmetric: only the lower triangle is computed
+template<int R, int K, typename V>
+MatV<R, R, V> similarity(MatV<R, K, V> const& a, MatV<K, K, V> const& s)
+{
+  auto as = a * s;
+  MatV<R, R, V> r;
+  for (int i = 0; i < R; ++i)
+    for (int j = 0; j <= i; ++j) {
+      V x = as(i, 0) * a(j, 0);
+      for (int k = 1; k < K; ++k)
+        x += as(i, k) * a(j, k);
+      r(i, j) = r(j, i) = x;
+    }
+  return r;
+}
+
+// 1/sqrt(x): the hardware estimate (12 bits, 14 with AVX-512) or the
+// "magic constant" one, refined by Newton-Raphson steps (approx_vrsqrt.h):
+// one is enough for float
+template<typename V>
+V rsqrtEstimate(V x)
+{
+  return approx_rsqrtf_E<V>::impl(x);
+}
+
+template<int NEWTON = 1, typename V>
+V rsqrt(V x)
+{
+  return approx_rsqrtf<V, NEWTON>(x);
+}
+
+// the inverse of a symmetric positive definite matrix
+template<int NEWTON = 1, int N, typename V>
+MatV<N, N, V> invertSymmetric(MatV<N, N, V> const& a)
+{
+  // A = L L^T, d[j] = 1 / L(j,j)
+  MatV<N, N, V> l;
+  V d[N];
+  for (int j = 0; j < N; ++j) {
+    V s = a(j, j);
+    for (int k = 0; k < j; ++k)
+      s -= l(j, k) * l(j, k);
+    d[j]    = rsqrt<NEWTON>(s);
+    l(j, j) = s * d[j];
+    for (int i = j + 1; i < N; ++i) {
+      V x = a(i, j);
+      for (int k = 0; k < j; ++k)
+        x -= l(i, k) * l(j, k);
+      l(i, j) = x * d[j];
+    }
+  }
+  // M = L^-1 (lower triangular), by forward substitution
+  MatV<N, N, V> m;
+  for (int j = 0; j < N; ++j) {
+    m(j, j) = d[j];
+    for (int i = j + 1; i < N; ++i) {
+      V x = l(i, j) * m(j, j);
+      for (int k = j + 1; k < i; ++k)
+        x += l(i, k) * m(k, j);
+      m(i, j) = -x * d[i];
+    }
+  }
+  // A^-1 = M^T M
+  MatV<N, N, V> r;
+  for (int i = 0; i < N; ++i)
+    for (int j = 0; j <= i; ++j) {
+      V x = m(i, i) * m(i, j);
+      for (int k = i + 1; k < N; ++k)
+        x += m(k, i) * m(k, j);
+      r(i, j) = r(j, i) = x;
+    }
+  return r;
+}
+
+// n matrices of R x C in blocks of VSIZE (the last block padded)
+template<int R, int C, typename V = nativeVector::FVect>
+class MatrixBatch
+{
+public:
+  using Block            = MatV<R, C, V>;
+  static constexpr int W = nativeVector::vsize<V>;
+
+  explicit MatrixBatch(std::size_t n)
+      : n_(n)
+      , blocks_((n + W - 1) / W)
+  {}
+
+  std::size_t size() const
+  {
+    return n_;
+  }
+  std::size_t nBlocks() const
+  {
+    return blocks_.size();
+  }
+
+  Block& block(std::size_t b)
+  {
+    return blocks_[b];
+  }
+  Block const& block(std::size_t b) const
+  {
+    return blocks_[b];
+  }
+
+  // element (i,j) of matrix k
+  float& operator()(std::size_t k, int i, int j)
+  {
+    return reinterpret_cast<float*>(&blocks_[k / W].m[i][j])[k % W];
+  }
+  float operator()(std::size_t k, int i, int j) const
+  {
+    return blocks_[k / W].m[i][j][k % W];
+  }
+
+private:
+  std::size_t n_;
+  std::vector<Block> blocks_;
+};
+
+// c = a + b
+template<int R, int C, typename V>
+void add(MatrixBatch<R, C, V> const& a, MatrixBatch<R, C, V> const& b,
+         MatrixBatch<R, C, V>& c)
+{
+  for (std::size_t i = 0; i < c.nBlocks(); ++i)
+    c.block(i) = a.block(i) + b.block(i);
+}
+
+// c = a b
+template<int R, int K, int C, typename V>
+void multiply(MatrixBatch<R, K, V> const& a, MatrixBatch<K, C, V> const& b,
+              MatrixBatch<R, C, V>& c)
+{
+  for (std::size_t i = 0; i < c.nBlocks(); ++i)
+    c.block(i) = a.block(i) * b.block(i);
+}
+
+// r = a s a^T
+template<int R, int K, typename V>
+void similarity(MatrixBatch<R, K, V> const& a, MatrixBatch<K, K, V> const& s,
+                MatrixBatch<R, R, V>& r)
+{
+  for (std::size_t i = 0; i < r.nBlocks(); ++i)
+    r.block(i) = similarity(a.block(i), s.block(i));
+}
+
+// r = a^-1, a symmetric positive definite
+template<int NEWTON = 1, int N, typename V>
+void invertSymmetric(MatrixBatch<N, N, V> const& a, MatrixBatch<N, N, V>& r)
+{
+  for (std::size_t i = 0; i < r.nBlocks(); ++i)
+    r.block(i) = invertSymmetric<NEWTON>(a.block(i));
+}
+
+} // namespace smallMatrix
+
+#endif
@@ -0,0 +1,217 @@
+//
+//  accuracy (in ulps) and speed of approx_vrsqrt.h against 1/std::sqrt,
+//  1/x and a/b, for 0, 1 and 2 Newton steps
+//
+//  c++ -O2 testApproxRsqrt.cpp                 (SSE estimate)
+//  c++ -O2 -march=native testApproxRsqrt.cpp   (AVX, AVX-512 estimates)
+//  ./a.out --filter=rsqrt
+//
+//  compare with c++ -Ofast: the compiler uses the estimate and one step for
+//  1/std::sqrt and divisions, everywhere
+//
+#include "../architecture/benchRunner.h"
+#include "approx_vrsqrt.h"
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace nativeVector;
+
+// no hardware estimate for these: the "magic constant" one
+typedef float __attribute__((vector_size(128))) float32x32_t;
+
+inline int diff(float x, float y)
+{
+  int i;
+  memcpy(&i, &x, sizeof(int));
+  int j;
+  memcpy(&j, &y, sizeof(int));
+  return std::abs(i - j);
+}
+
+// max and average ulps of f against the correctly rounded ref over all the
+// floats x in [1, 4) and 2^24 random normal ones, W at a time (a is the
+// numerator of the divisions)
+template<typename Float, typename F, typename R>
+void ulps(char const* what, F f, R ref)
+{
+  constexpr int W = vsize<Float>;
+  int mxDiff      = 0;
+  long long avDiff = 0;
+  long long n      = 0;
+  auto check       = [&](Float x, Float a) {
+    auto y = f(x, a);
+    for (int l = 0; l < W; ++l) {
+      auto d = diff(y[l], float(ref(double(x[l]), double(a[l]))));
+      avDiff += d;
+      mxDiff = std::max(mxDiff, d);
+    }
+    n += W;
+  };
+  float one = 1.f, four = 4.f;
+  int i1, i4;
+  memcpy(&i1, &one, sizeof(int));
+  memcpy(&i4, &four, sizeof(int));
+  Float x, a;
+  for (int i = i1; i < i4; i += W) {
+    for (int l = 0; l < W; ++l) {
+      int j = i + l;
+      memcpy(&x[l], &j, sizeof(int));
+      a[l] = 3.f;
+    }
+    check(x, a);
+  }
+  // exponents from -100 to 100 for x, -20 to 20 for a (a/x must stay
+  // normal)
+  std::mt19937 eng;
+  std::uniform_int_distribution<int> xbits(0x0d800000, 0x71ffffff);
+  std::uniform_int_distribution<int> abits(0x35800000, 0x49ffffff);
+  for (int i = 0; i < (1 << 24); i += W) {
+    for (int l = 0; l < W; ++l) {
+      int j = xbits(eng), k = abits(eng);
+      memcpy(&x[l], &j, sizeof(int));
+      memcpy(&a[l], &k, sizeof(int));
+    }
+    check(x, a);
+  }
+  std::cout << what << " max " << mxDiff << " ave " << std::setprecision(3)
+            << double(avDiff) / n << std::endl;
+}
+
+template<typename Float, int NEWTON>
+void accuracy(char const* name)
+{
+  std::cout << name << " NEWTON " << NEWTON << std::endl;
+  ulps<Float>(
+      "  rsqrt",
+      [](Float x, Float) { return approx_rsqrtf<Float, NEWTON>(x); },
+      [](double x, double) { return 1. / std::sqrt(x); });
+  ulps<Float>(
+      "  rcp  ", [](Float x, Float) { return approx_rcpf<Float, NEWTON>(x); },
+      [](double x, double) { return 1. / x; });
+  ulps<Float>(
+      "  div  ",
+      [](Float x, Float a) { return approx_divf<Float, NEWTON>(a, x); },
+      [](double x, double a) { return a / x; });
+}
+
+template<typename Float>
+void accuracy(char const* name)
+{
+  accuracy<Float, 0>(name);
+  accuracy<Float, 1>(name);
+  accuracy<Float, 2>(name);
+}
+
+void accuracy()
+{
+#ifdef __AVX512F__
+  accuracy<float32x16_t>("AVX-512");
+#endif
+#ifdef __AVX__
+  accuracy<float32x8_t>("AVX");
+#endif
+  accuracy<float32x4_t>("SSE");
+  accuracy<float32x32_t>("magic constant");
+}
+
+// 4 KB: in the L1, the kernels are limited by the latency (or the
+// throughput) of the operations
+constexpr int N = 1024 / VSIZE;
+
+std::vector<FVect>& data()
+{
+  static std::vector<FVect> x = [] {
+    std::mt19937 eng;
+    std::uniform_real_distribution<float> rgen(0.1f, 100.f);
+    std::vector<FVect> v(N);
+    for (auto& y : v)
+      for (unsigned int l = 0; l < VSIZE; ++l)
+        y[l] = rgen(eng);
+    return v;
+  }();
+  return x;
+}
+
+template<typename F>
+void applyKernel(benchmark::State& st, F f)
+{
+  auto& x = data();
+  std::vector<FVect> y(N);
+  st.setItems(N * VSIZE);
+  while (st.next()) {
+    benchmark::touch(x);
+    for (int i = 0; i < N; ++i)
+      y[i] = f(x[i], x[N - 1 - i]);
+    benchmark::keep(y);
+  }
+}
+
+// sqrtps (std::sqrt is not vectorized without -fno-math-errno)
+FVect sqrt(FVect x)
+{
+#ifdef __AVX__
+  return (FVect)_mm256_sqrt_ps((__m256)x);
+#else
+  return (FVect)_mm_sqrt_ps((__m128)x);
+#endif
+}
+
+void rsqrtStd(benchmark::State& st)
+{
+  applyKernel(st, [](FVect x, FVect) { return 1.f / sqrt(x); });
+}
+
+template<int NEWTON>
+void rsqrtApprox(benchmark::State& st)
+{
+  applyKernel(st,
+              [](FVect x, FVect) { return approx_rsqrtf<FVect, NEWTON>(x); });
+}
+
+void rcpStd(benchmark::State& st)
+{
+  applyKernel(st, [](FVect x, FVect) { return 1.f / x; });
+}
+
+template<int NEWTON>
+void rcpApprox(benchmark::State& st)
+{
+  applyKernel(st, [](FVect x, FVect) { return approx_rcpf<FVect, NEWTON>(x); });
+}
+
+void divStd(benchmark::State& st)
+{
+  applyKernel(st, [](FVect x, FVect a) { return a / x; });
+}
+
+template<int NEWTON>
+void divApprox(benchmark::State& st)
+{
+  applyKernel(st,
+              [](FVect x, FVect a) { return approx_divf<FVect, NEWTON>(a, x); });
+}
+
+BENCHMARK(rsqrtStd);
+BENCHMARK(rsqrtApprox<0>);
+BENCHMARK(rsqrtApprox<1>);
+BENCHMARK(rsqrtApprox<2>);
+BENCHMARK(rcpStd);
+BENCHMARK(rcpApprox<0>);
+BENCHMARK(rcpApprox<1>);
+BENCHMARK(rcpApprox<2>);
+BENCHMARK(divStd);
+BENCHMARK(divApprox<0>);
+BENCHMARK(divApprox<1>);
+BENCHMARK(divApprox<2>);
+
+int main(int argc, char** argv)
+{
+  accuracy();
+  std::cout << "working with batch of " << N * VSIZE << " floats" << std::endl;
+  return benchmark::main(argc, argv);
+}
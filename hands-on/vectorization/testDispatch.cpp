@@ -0,0 +1,155 @@
+//
+//  the same vector code compiled for SSE4, AVX2 and AVX-512 in one binary,
+//  the version is chosen at startup (see ../architecture/isaDispatch.h)
+//
+//  c++ -O2 -Wno-psabi testDispatch.cpp
+//  BENCH_ISA=sse4 ./a.out       (force a version, never above the host)
+//
+//  compare with the same kernels compiled with -march=native
+//
+#include "../architecture/benchRunner.h"
+#include "../architecture/isaDispatch.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "approx_vexp.h"
+#include "approx_vlog.h"
+#include "simpleSinCos.h"
+
+constexpr int N    = 1 << 14;
+constexpr int NBin = 100;
+
+template<typename V>
+V loadV(float const* p)
+{
+  V v;
+  memcpy(&v, p, sizeof(V));
+  return v;
+}
+
+template<typename V>
+void storeV(float* p, V v)
+{
+  memcpy(p, &v, sizeof(V));
+}
+
+// y = exp(log(x)) (N is a multiple of any vector size)
+template<typename V>
+inline void expLogBody(float const* x, float* y)
+{
+  constexpr int W = nativeVector::vsize<V>;
+  for (int i = 0; i < N; i += W) {
+    V v = loadV<V>(x + i);
+    storeV(y + i, approx_expf<V, 6, true>(approx_logf<V, 8>(v)));
+  }
+}
+
+// the polar to cartesian part of binning, the bins in a vector of ints
+template<typename V>
+inline void binBody(float const* phi, float const* r, int* xbin, int* ybin)
+{
+  using namespace nativeVector;
+  using Int                 = typename toIF<V>::itype;
+  constexpr int W           = vsize<V>;
+  constexpr float binWidthI = NBin / 2.f;
+  for (int i = 0; i < N; i += W) {
+    V s, c;
+    simpleSinCos(loadV<V>(phi + i), s, c);
+    V rr   = loadV<V>(r + i);
+    Int xb = toIF<V>::convert((rr * c + 1.f) * binWidthI);
+    Int yb = toIF<V>::convert((rr * s + 1.f) * binWidthI);
+    memcpy(xbin + i, &xb, sizeof(Int));
+    memcpy(ybin + i, &yb, sizeof(Int));
+  }
+}
+
+using ExpLog = void (*)(float const*, float*);
+using Bin    = void (*)(float const*, float const*, int*, int*);
+
+ISA_SSE4 void expLogSSE4(float const* x, float* y)
+{
+  expLogBody<nativeVector::float32x4_t>(x, y);
+}
+ISA_AVX2 void expLogAVX2(float const* x, float* y)
+{
+  expLogBody<nativeVector::float32x8_t>(x, y);
+}
+ISA_AVX512 void expLogAVX512(float const* x, float* y)
+{
+  expLogBody<nativeVector::float32x16_t>(x, y);
+}
+
+ISA_SSE4 void binSSE4(float const* phi, float const* r, int* xb, int* yb)
+{
+  binBody<nativeVector::float32x4_t>(phi, r, xb, yb);
+}
+ISA_AVX2 void binAVX2(float const* phi, float const* r, int* xb, int* yb)
+{
+  binBody<nativeVector::float32x8_t>(phi, r, xb, yb);
+}
+ISA_AVX512 void binAVX512(float const* phi, float const* r, int* xb, int* yb)
+{
+  binBody<nativeVector::float32x16_t>(phi, r, xb, yb);
+}
+
+void expLogKernel(benchmark::State& st)
+{
+  static ExpLog const expLog =
+      isa::select(expLogSSE4, expLogAVX2, expLogAVX512);
+  std::mt19937 eng;
+  std::uniform_real_distribution<float> rgen(0.01f, 10.f);
+  std::vector<float> x(N), y(N);
+  for (auto& v : x)
+    v = rgen(eng);
+
+  st.setItems(N);
+  st.setBytes(8. * N);
+  while (st.next()) {
+    expLog(x.data(), y.data());
+    benchmark::keep(y);
+  }
+  double maxErr = 0;
+  for (int i = 0; i < N; ++i)
+    maxErr = std::max(maxErr, std::abs(double(y[i]) - x[i]) / x[i]);
+  std::cout << "exp(log(x)) max rel error " << maxErr << std::endl;
+}
+
+void binningKernel(benchmark::State& st)
+{
+  static Bin const bin = isa::select(binSSE4, binAVX2, binAVX512);
+  std::mt19937 eng;
+  std::uniform_real_distribution<float> rgen(0., 1.);
+  std::vector<float> phi(N), r(N);
+  std::vector<int> xb(N), yb(N);
+  for (int i = 0; i < N; ++i) {
+    phi[i] = -M_PI + 2. * M_PI * rgen(eng);
+    r[i]   = rgen(eng);
+  }
+
+  // 35 flops with simpleSinCos
+  st.setItems(N);
+  st.setFlops(35. * N);
+  st.setBytes(16. * N);
+  while (st.next()) {
+    bin(phi.data(), r.data(), xb.data(), yb.data());
+    benchmark::keep(xb);
+    benchmark::keep(yb);
+  }
+  std::vector<int> h((NBin + 1) * (NBin + 1));
+  for (int i = 0; i < N; ++i)
+    ++h[xb[i] * (NBin + 1) + yb[i]];
+  std::cout << "center bin " << h[(NBin / 2) * (NBin + 2)] << std::endl;
+}
+
+BENCHMARK(expLogKernel);
+BENCHMARK(binningKernel);
+
+int main(int argc, char** argv)
+{
+  std::cout << "running the " << isa::name(isa::selected()) << " version"
+            << std::endl;
+  return benchmark::main(argc, argv);
+}
@@ -1,4 +1,4 @@
-#include "../architecture/benchmark.h"
+#include "../architecture/benchRunner.h"
 #include <array>
 #include <bitset>
 #include <chrono>
@@ -21,7 +21,7 @@ inline int diff(float x, float y)
   return std::abs(i - j);
 }
 
-int main()
+void accuracy()
 {
   // float ff = 16.f*std::numeric_limits<float>::min();
   float ff = std::numeric_limits<float>::epsilon();
@@ -91,12 +91,17 @@ int main()
     std::cout << fDiff << std::endl;
   }
 
-  // timing
-  auto start = std::chrono::high_resolution_clock::now();
-  auto delta = start - start;
+}
 
-  constexpr int N = 1 << 8;
-  std::cout << "working with batch of " << N << " angles" << std::endl;
+constexpr int N = 1 << 8;
+
+// median ns per batch, for the f/s line printed after the runs
+double simpleTime = 0;
+double fastTime   = 0;
+
+template<typename F>
+void sinCosKernel(benchmark::State& st, double& median, F sincos)
+{
   std::array<float, N> p;
   std::array<float, N> x;
   std::array<float, N> y;
@@ -106,64 +111,52 @@ int main()
     for (int j = 1; j < 8; ++j)
       p[i + j] = p[i + j - 1] + float(M_PI / 4.);
   };
-  auto comp = [&](int i) {
-    y[i] = simpleSin(p[i]);
-    x[i] = simpleCos(p[i]);
-  };
-
-  auto compf = [&](int i) {
-    y[i] = fast_sinf(p[i]);
-    x[i] = fast_cosf(p[i]);
-  };
 
-  delta = start - start;
-  for (auto kk = 0; kk < 100; ++kk)
-    for (float zz = -M_PI; zz < (-M_PI + M_PI / 4. - 0.001); zz += 4.e-7f) {
-      for (auto j = 0; j < N; j += 8) {
-        zz += 4.e-7f;
-        load(j, zz);
-      }
-      delta -= (std::chrono::high_resolution_clock::now() - start);
-      benchmark::touch(p);
-      for (auto j = 0; j < N; ++j)
-        comp(j);
-      benchmark::keep(x);
-      benchmark::keep(y);
-      delta += (std::chrono::high_resolution_clock::now() - start);
+  st.setItems(N);
+  float zz = -M_PI;
+  while (st.next()) {
+    st.pause();
+    if (zz > (-M_PI + M_PI / 4. - 0.001))
+      zz = -M_PI;
+    for (auto j = 0; j < N; j += 8) {
+      zz += 4.e-7f;
+      load(j, zz);
     }
+    st.resume();
+    benchmark::touch(p);
+    for (auto j = 0; j < N; ++j)
+      sincos(p[j], y[j], x[j]);
+    benchmark::keep(x);
+    benchmark::keep(y);
+  }
+  median = benchmark::Stats::compute(st.samples(), 5.).median;
+}
 
-  std::cout
-      << "Simple Computation took "
-      << std::chrono::duration_cast<std::chrono::milliseconds>(delta).count()
-      << " ms" << std::endl;
-  double deltaS =
-      std::chrono::duration_cast<std::chrono::milliseconds>(delta).count();
-
-  delta = start - start;
-  delta = start - start;
-  for (auto kk = 0; kk < 100; ++kk)
-    for (float zz = -M_PI; zz < (-M_PI + M_PI / 4. - 0.001); zz += 4.e-7f) {
-      for (auto j = 0; j < N; j += 8) {
-        zz += 4.e-7f;
-        load(j, zz);
-      }
-      delta -= (std::chrono::high_resolution_clock::now() - start);
-      benchmark::touch(p);
-      for (auto j = 0; j < N; ++j)
-        compf(j);
-      benchmark::keep(x);
-      benchmark::keep(y);
-      delta += (std::chrono::high_resolution_clock::now() - start);
-    }
+void simpleKernel(benchmark::State& st)
+{
+  sinCosKernel(st, simpleTime, [](float p, float& s, float& c) {
+    s = simpleSin(p);
+    c = simpleCos(p);
+  });
+}
 
-  std::cout
-      << "fast Computation took "
-      << std::chrono::duration_cast<std::chrono::milliseconds>(delta).count()
-      << " ms" << std::endl;
-  double deltaF =
-      std::chrono::duration_cast<std::chrono::milliseconds>(delta).count();
+void fastKernel(benchmark::State& st)
+{
+  sinCosKernel(st, fastTime, [](float p, float& s, float& c) {
+    s = fast_sinf(p);
+    c = fast_cosf(p);
+  });
+}
 
-  std::cout << "f/s " << deltaF / deltaS << std::endl;
+BENCHMARK(simpleKernel);
+BENCHMARK(fastKernel);
 
-  return 0;
+int main(int argc, char** argv)
+{
+  accuracy();
+  std::cout << "working with batch of " << N << " angles" << std::endl;
+  auto rc = benchmark::main(argc, argv);
+  if (simpleTime > 0 && fastTime > 0)
+    std::cout << "f/s " << fastTime / simpleTime << std::endl;
+  return rc;
 }